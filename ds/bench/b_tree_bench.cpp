@@ -0,0 +1,90 @@
+#include "bench.hpp"
+
+#include <ds/b_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <map>
+
+namespace
+{
+
+// Same order as std::less<int>, but hides the key search from the vector
+// kernels of b_tree_t.
+struct int_less_t
+{
+   bool operator()(int lhs, int rhs) const
+   {
+      return lhs < rhs;
+   }
+};
+
+template <typename MapType>
+void put(MapType& m, int k, int v)
+{
+   m.put(k, v);
+}
+
+void put(std::map<int, int>& m, int k, int v)
+{
+   m[k] = v;
+}
+
+template <typename MapType>
+bool contains(const MapType& m, int k)
+{
+   return m.get(k) != nullptr;
+}
+
+bool contains(const std::map<int, int>& m, int k)
+{
+   return m.find(k) != m.end();
+}
+
+template <typename MapType>
+void run(const char* name, const std::vector<int>& keys,
+         const std::vector<int>& probes)
+{
+   const auto n = keys.size();
+   std::size_t found = 0;
+   long long sum = 0;
+   {
+      MapType m;
+      bench::report(name, "insert", n, bench::time_ms([&] {
+         for (auto k : keys)
+            put(m, k, k);
+      }));
+
+      bench::report(name, "get", probes.size(), bench::time_ms([&] {
+         for (auto k : probes)
+            found += contains(m, k);
+      }));
+
+      bench::report(name, "scan", n, bench::time_ms([&] {
+         for (const auto& kv : m)
+            sum += kv.second;
+      }));
+   }
+   bench::escape(found);
+   bench::escape(sum);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+   const auto keys = bench::shuffled_keys(n);
+   const auto probes = bench::shuffled_keys(n, 7);
+
+   run<std::map<int, int>>("std::map", keys, probes);
+   run<ds::rb_tree_t<int, int>>("rb_tree_t", keys, probes);
+   run<ds::b_tree_t<int, int, std::less<int>, 16>>("b_tree_t/16", keys,
+                                                    probes);
+   run<ds::b_tree_t<int, int, int_less_t>>("b_tree_t/default/binary", keys,
+                                           probes);
+   run<ds::b_tree_t<int, int>>("b_tree_t/default", keys, probes);
+   run<ds::b_tree_t<int, int, std::less<int>, 256>>("b_tree_t/256", keys,
+                                                     probes);
+
+   return 0;
+}
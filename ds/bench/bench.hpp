@@ -0,0 +1,61 @@
+#ifndef DATASTRUCTURES_BENCH_HPP
+#define DATASTRUCTURES_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace bench
+{
+
+template <typename FunType>
+double time_ms(FunType f)
+{
+   const auto start = std::chrono::steady_clock::now();
+   f();
+   const auto stop = std::chrono::steady_clock::now();
+   return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+inline std::size_t arg_size(int argc, char** argv, int i, std::size_t def)
+{
+   if (argc > i)
+      return static_cast<std::size_t>(std::strtoull(argv[i], nullptr, 10));
+   return def;
+}
+
+inline std::vector<int> shuffled_keys(std::size_t n, unsigned seed = 42)
+{
+   std::vector<int> keys(n);
+   std::iota(keys.begin(), keys.end(), 0);
+   std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+   return keys;
+}
+
+inline void report(const char* name, const char* op, std::size_t n, double ms)
+{
+   std::printf("%-24s %-12s %10zu ops %10.2f ms %8.2f Mops/s\n",
+               name, op, n, ms, ms > 0 ? n / ms / 1000.0 : 0.0);
+}
+
+// Keeps the optimizer from discarding benchmarked results: the value has to
+// be materialized in memory, which the compiler must assume is read.
+template <typename T>
+inline void escape(const T& value)
+{
+#if defined(__GNUC__)
+   asm volatile("" : : "g"(&value) : "memory");
+#else
+   static const void* volatile sink;
+   sink = &value;
+#endif
+}
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "bench.hpp"
+
+#include <ds/coro_lookup.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <cstdio>
+#include <string>
+
+#ifdef DS_HAS_COROUTINES
+
+namespace
+{
+
+void run(std::size_t n, std::size_t width)
+{
+   const auto keys = bench::shuffled_keys(n);
+   const auto probes = bench::shuffled_keys(n, 7);
+
+   ds::rb_tree_t<int, int> t;
+   for (auto k : keys)
+      t.put(k, k);
+
+   std::vector<int*> values(probes.size());
+   std::vector<std::size_t> ranks(probes.size());
+   long long sum = 0;
+   const auto name = "rb_tree_t/" + std::to_string(n);
+
+   bench::report(name.c_str(), "get", probes.size(), bench::time_ms([&] {
+      for (std::size_t i = 0; i < probes.size(); ++i)
+         values[i] = t.get(probes[i]);
+      sum += *values[0];
+      bench::escape(sum);
+   }));
+
+   bench::report(name.c_str(), "co_get", probes.size(), bench::time_ms([&] {
+      ds::lookup_scheduler_t s(width);
+      for (std::size_t i = 0; i < probes.size(); ++i)
+         s.spawn(ds::co_get(t, probes[i], values[i]));
+      s.run();
+      sum += *values[0];
+      bench::escape(sum);
+   }));
+
+   // half gets, half ranks
+   bench::report(name.c_str(), "get+rank", probes.size(), bench::time_ms([&] {
+      for (std::size_t i = 0; i < probes.size(); ++i)
+      {
+         if (i % 2)
+            ranks[i] = t.rank(probes[i]);
+         else
+            values[i] = t.get(probes[i]);
+      }
+      sum += *values[0] + ranks[1];
+      bench::escape(sum);
+   }));
+
+   bench::report(name.c_str(), "co_get+rank", probes.size(),
+                 bench::time_ms([&] {
+      ds::lookup_scheduler_t s(width);
+      for (std::size_t i = 0; i < probes.size(); ++i)
+      {
+         if (i % 2)
+            s.spawn(ds::co_rank(t, probes[i], ranks[i]));
+         else
+            s.spawn(ds::co_get(t, probes[i], values[i]));
+      }
+      s.run();
+      sum += *values[0] + ranks[1];
+      bench::escape(sum);
+   }));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto max_n = bench::arg_size(argc, argv, 1, 1 << 22);
+   const auto width = bench::arg_size(argc, argv, 2, 32);
+
+   for (std::size_t n = 1 << 12; n <= max_n; n <<= 2)
+      run(n, width);
+   return 0;
+}
+
+#else
+
+int main()
+{
+   std::puts("coroutines are not supported by this compiler");
+   return 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "bench.hpp"
+
+#include <ds/persistent_rb_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+// Reads are done in batches of consistent, point-in-time lookups.
+const std::size_t batch = 100;
+
+// One writer puts random keys for duration_ms while nb_readers threads run
+// batches of gets, each against a snapshot or under the lock.
+template <typename WriteType, typename ReadType>
+void run(const char* name, std::size_t nb_readers, double duration_ms,
+         WriteType write, ReadType read)
+{
+   std::atomic<bool> done(false);
+   std::atomic<std::size_t> nb_reads(0);
+   std::vector<std::thread> readers;
+   for (std::size_t r = 0; r < nb_readers; ++r)
+   {
+      readers.emplace_back([&, r] {
+         std::size_t reads = 0;
+         std::size_t found = 0;
+         auto probes = bench::shuffled_keys(1 << 16, static_cast<unsigned>(r));
+         for (std::size_t i = 0; !done; i = (i + batch) % probes.size())
+         {
+            found += read(&probes[i]);
+            reads += batch;
+         }
+         bench::escape(found);
+         nb_reads += reads;
+      });
+   }
+
+   const auto keys = bench::shuffled_keys(1 << 20, 99);
+   std::size_t nb_writes = 0;
+   const auto ms = bench::time_ms([&] {
+      const auto start = std::chrono::steady_clock::now();
+      while (std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count() <
+             duration_ms)
+      {
+         for (std::size_t i = 0; i < 1000; ++i, ++nb_writes)
+            write(keys[nb_writes % keys.size()]);
+      }
+   });
+   done = true;
+   for (auto& r : readers)
+      r.join();
+
+   const auto label = std::string(name) + "/" + std::to_string(nb_readers);
+   bench::report(label.c_str(), "put", nb_writes, ms);
+   bench::report(label.c_str(), "get", nb_reads, ms);
+}
+
+void run_persistent(std::size_t n, std::size_t nb_readers, double ms)
+{
+   ds::persistent_rb_tree_t<int, int> t;
+   for (auto k : bench::shuffled_keys(n))
+      t.put(k, k);
+
+   run("persistent", nb_readers, ms,
+       [&](int k) { t.put(k % static_cast<int>(n), k); },
+       [&](const int* probes) {
+          const auto s = t.snapshot();
+          std::size_t found = 0;
+          for (std::size_t i = 0; i < batch; ++i)
+             found += s.get(probes[i]) != nullptr;
+          return found;
+       });
+}
+
+void run_locked(std::size_t n, std::size_t nb_readers, double ms)
+{
+   ds::rb_tree_t<int, int> t;
+   for (auto k : bench::shuffled_keys(n))
+      t.put(k, k);
+   std::mutex mutex;
+
+   run("locked", nb_readers, ms,
+       [&](int k) {
+          std::lock_guard<std::mutex> lock(mutex);
+          t.put(k % static_cast<int>(n), k);
+       },
+       [&](const int* probes) {
+          std::lock_guard<std::mutex> lock(mutex);
+          std::size_t found = 0;
+          for (std::size_t i = 0; i < batch; ++i)
+             found += t.get(probes[i]) != nullptr;
+          return found;
+       });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 16);
+   const auto ms = static_cast<double>(bench::arg_size(argc, argv, 2, 1000));
+
+   for (std::size_t nb_readers : {0, 1, 2, 4, 8})
+   {
+      run_locked(n, nb_readers, ms);
+      run_persistent(n, nb_readers, ms);
+   }
+   return 0;
+}
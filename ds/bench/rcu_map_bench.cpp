@@ -0,0 +1,97 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+#include <ds/rcu_map.hpp>
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+using clock_t = std::chrono::steady_clock;
+
+// nb_readers threads run gets for duration_ms while one writer keeps
+// putting keys. Everybody stops at
+// the deadline, since a reader-preferring lock may starve the writer.
+template <typename ReadType, typename WriteType>
+void run(const char* name, std::size_t n, std::size_t nb_readers,
+         double duration_ms, ReadType read, WriteType write)
+{
+   const auto deadline = clock_t::now() +
+      std::chrono::microseconds(static_cast<long long>(duration_ms * 1000));
+   std::atomic<std::size_t> nb_reads(0);
+   std::size_t nb_writes = 0;
+   std::vector<std::thread> readers;
+
+   const auto ms = bench::time_ms([&] {
+      for (std::size_t r = 0; r < nb_readers; ++r)
+      {
+         readers.emplace_back([&, r] {
+            const auto probes =
+               bench::shuffled_keys(n, static_cast<unsigned>(r));
+            std::size_t reads = 0;
+            std::size_t found = 0;
+            while (clock_t::now() < deadline)
+            {
+               for (std::size_t i = 0; i < 256; ++i)
+                  found += read(probes[(reads + i) % n]);
+               reads += 256;
+            }
+            bench::escape(found);
+            nb_reads += reads;
+         });
+      }
+
+      while (clock_t::now() < deadline)
+      {
+         write(static_cast<int>(nb_writes % n));
+         ++nb_writes;
+      }
+      for (auto& r : readers)
+         r.join();
+   });
+
+   const auto label = std::string(name) + "/" + std::to_string(nb_readers);
+   bench::report(label.c_str(), "get", nb_reads, ms);
+   bench::report(label.c_str(), "put", nb_writes, ms);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 16);
+   const auto ms = static_cast<double>(bench::arg_size(argc, argv, 2, 200));
+   const auto max_readers = bench::arg_size(argc, argv, 3, 64);
+
+   for (std::size_t r = 1; r <= max_readers; r *= 2)
+   {
+      {
+         ds::rb_tree_t<int, int> t;
+         for (auto k : bench::shuffled_keys(n))
+            t.put(k, k);
+         std::shared_mutex mutex;
+         run("shared_mutex", n, r, ms,
+             [&](int k) {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                return t.get(k) != nullptr;
+             },
+             [&](int k) {
+                std::unique_lock<std::shared_mutex> lock(mutex);
+                t.put(k, k + 1);
+             });
+      }
+      {
+         ds::rcu_map_t<int, int> t;
+         for (auto k : bench::shuffled_keys(n))
+            t.put(k, k);
+         run("rcu_map", n, r, ms,
+             [&](int k) { return t.contains(k); },
+             [&](int k) { t.put(k, k + 1); });
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,87 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+#include <ds/sharded_map.hpp>
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+// nb_threads threads run nb_ops operations each on keys of [0, n), one put
+// every put_period operations and gets otherwise.
+template <typename GetType, typename PutType>
+void run(const char* name, std::size_t n, std::size_t nb_threads,
+         std::size_t nb_ops, std::size_t put_period, GetType get, PutType put)
+{
+   std::vector<std::thread> threads;
+
+   const auto ms = bench::time_ms([&] {
+      for (std::size_t t = 0; t < nb_threads; ++t)
+      {
+         threads.emplace_back([&, t] {
+            const auto keys =
+               bench::shuffled_keys(n, static_cast<unsigned>(t));
+            std::size_t found = 0;
+            for (std::size_t i = 0; i < nb_ops; ++i)
+            {
+               const auto k = keys[i % n];
+               if (i % put_period == 0)
+                  put(k);
+               else
+                  found += get(k);
+            }
+            bench::escape(found);
+         });
+      }
+      for (auto& t : threads)
+         t.join();
+   });
+
+   const auto label = std::string(name) + "/" + std::to_string(nb_threads);
+   const auto op = "1/" + std::to_string(put_period) + " put";
+   bench::report(label.c_str(), op.c_str(), nb_threads * nb_ops, ms);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 16);
+   const auto nb_ops = bench::arg_size(argc, argv, 2, 1 << 20);
+   const auto max_threads = bench::arg_size(argc, argv, 3, 16);
+
+   for (std::size_t put_period : {10, 2})
+   {
+      for (std::size_t nb_threads = 1; nb_threads <= max_threads;
+           nb_threads *= 2)
+      {
+         {
+            ds::rb_tree_t<int, int> t;
+            for (auto k : bench::shuffled_keys(n))
+               t.put(k, k);
+            std::mutex mutex;
+            run("mutex", n, nb_threads, nb_ops, put_period,
+                [&](int k) {
+                   std::lock_guard<std::mutex> lock(mutex);
+                   return t.get(k) != nullptr;
+                },
+                [&](int k) {
+                   std::lock_guard<std::mutex> lock(mutex);
+                   t.put(k, k + 1);
+                });
+         }
+         {
+            ds::sharded_map_t<int, int> t;
+            for (auto k : bench::shuffled_keys(n))
+               t.put(k, k);
+            run("sharded_map", n, nb_threads, nb_ops, put_period,
+                [&](int k) { return t.contains(k); },
+                [&](int k) { t.put(k, k + 1); });
+         }
+      }
+   }
+   return 0;
+}
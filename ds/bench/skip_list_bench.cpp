@@ -0,0 +1,98 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+#include <ds/skip_list.hpp>
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+// nb_threads threads run nb_ops operations each on keys of [0, n): 40% puts,
+// 40% removes and 20% gets, so that the key set stays about the same size.
+template <typename GetType, typename PutType, typename RemoveType>
+void run(const char* name, std::size_t n, std::size_t nb_threads,
+         std::size_t nb_ops, GetType get, PutType put, RemoveType remove)
+{
+   std::vector<std::thread> threads;
+
+   const auto ms = bench::time_ms([&] {
+      for (std::size_t t = 0; t < nb_threads; ++t)
+      {
+         threads.emplace_back([&, t] {
+            const auto keys =
+               bench::shuffled_keys(n, static_cast<unsigned>(t));
+            std::size_t found = 0;
+            for (std::size_t i = 0; i < nb_ops; ++i)
+            {
+               const auto k = keys[i % n];
+               switch (i % 5)
+               {
+               case 0:
+               case 1:
+                  put(k);
+                  break;
+               case 2:
+               case 3:
+                  found += remove(k);
+                  break;
+               default:
+                  found += get(k);
+               }
+            }
+            bench::escape(found);
+         });
+      }
+      for (auto& t : threads)
+         t.join();
+   });
+
+   const auto label = std::string(name) + "/" + std::to_string(nb_threads);
+   bench::report(label.c_str(), "mixed", nb_threads * nb_ops, ms);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 16);
+   const auto nb_ops = bench::arg_size(argc, argv, 2, 1 << 20);
+   const auto max_threads = bench::arg_size(argc, argv, 3, 16);
+
+   for (std::size_t nb_threads = 1; nb_threads <= max_threads;
+        nb_threads *= 2)
+   {
+      {
+         ds::rb_tree_t<int, int> t;
+         for (auto k : bench::shuffled_keys(n))
+            t.put(k, k);
+         std::mutex mutex;
+         run("mutex", n, nb_threads, nb_ops,
+             [&](int k) {
+                std::lock_guard<std::mutex> lock(mutex);
+                return t.get(k) != nullptr;
+             },
+             [&](int k) {
+                std::lock_guard<std::mutex> lock(mutex);
+                t.put(k, k);
+             },
+             [&](int k) {
+                std::lock_guard<std::mutex> lock(mutex);
+                t.remove(k);
+                return true;
+             });
+      }
+      {
+         ds::skip_list_t<int, int> t;
+         for (auto k : bench::shuffled_keys(n))
+            t.put(k, k);
+         run("skip_list", n, nb_threads, nb_ops,
+             [&](int k) { return t.contains(k); },
+             [&](int k) { t.put(k, k); },
+             [&](int k) { return t.remove(k); });
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,60 @@
+#include "bench.hpp"
+
+#include <ds/bs_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <functional>
+
+namespace
+{
+
+template <typename TreeType>
+void run(const char* name, const std::vector<int>& keys)
+{
+   const auto n = keys.size();
+   std::size_t found = 0;
+   {
+      TreeType t;
+      bench::report(name, "insert", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.put(k, k);
+      }));
+
+      bench::report(name, "get", n, bench::time_ms([&] {
+         for (auto k : keys)
+            found += t.get(k) != nullptr;
+      }));
+
+      bench::report(name, "remove", n / 2, bench::time_ms([&] {
+         for (std::size_t i = 0; i < n / 2; ++i)
+            t.remove(keys[i]);
+      }));
+
+      bench::report(name, "reinsert", n / 2, bench::time_ms([&] {
+         for (std::size_t i = 0; i < n / 2; ++i)
+            t.put(keys[i], keys[i]);
+      }));
+
+      bench::report(name, "destroy", n, bench::time_ms([&] {
+         TreeType tmp(std::move(t));
+      }));
+   }
+   bench::escape(found);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+   const auto keys = bench::shuffled_keys(n);
+
+   run<ds::bs_tree_t<int, int>>("bs_tree_t/heap", keys);
+   run<ds::bs_tree_t<int, int, std::less<int>, ds::pool_alloc_t>>(
+      "bs_tree_t/pool", keys);
+   run<ds::rb_tree_t<int, int>>("rb_tree_t/heap", keys);
+   run<ds::rb_tree_t<int, int, std::less<int>, ds::pool_alloc_t>>(
+      "rb_tree_t/pool", keys);
+
+   return 0;
+}
@@ -0,0 +1,64 @@
+#include "bench.hpp"
+
+#include <ds/bs_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <functional>
+#include <utility>
+
+namespace
+{
+
+using kvs_t = std::vector<std::pair<int, int>>;
+
+template <typename TreeType>
+void run_put(const char* name, const kvs_t& kvs)
+{
+   TreeType t;
+   bench::report(name, "put", kvs.size(), bench::time_ms([&] {
+      for (const auto& kv : kvs)
+         t.put(kv.first, kv.second);
+   }));
+   bench::escape(t);
+}
+
+template <typename TreeType>
+void run_assign_sorted(const char* name, const kvs_t& kvs)
+{
+   TreeType t;
+   bench::report(name, "assign_sorted", kvs.size(), bench::time_ms([&] {
+      t.assign_sorted(kvs.begin(), kvs.end());
+   }));
+
+   std::size_t found = 0;
+   bench::report(name, "get", kvs.size(), bench::time_ms([&] {
+      for (const auto& kv : kvs)
+         found += t.get(kv.first) != nullptr;
+   }));
+   bench::escape(found);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+
+   kvs_t kvs;
+   kvs.reserve(n);
+   for (std::size_t i = 0; i < n; ++i)
+      kvs.emplace_back(static_cast<int>(i), static_cast<int>(i));
+
+   using rb_t = ds::rb_tree_t<int, int>;
+   using rb_pool_t = ds::rb_tree_t<int, int, std::less<int>, ds::pool_alloc_t>;
+   using bs_t = ds::bs_tree_t<int, int>;
+
+   run_put<rb_t>("rb_tree_t/heap", kvs);
+   run_assign_sorted<rb_t>("rb_tree_t/heap", kvs);
+   run_put<rb_pool_t>("rb_tree_t/pool", kvs);
+   run_assign_sorted<rb_pool_t>("rb_tree_t/pool", kvs);
+   // sorted puts degenerate bs_tree_t into a list, only bulk load it
+   run_assign_sorted<bs_t>("bs_tree_t/heap", kvs);
+
+   return 0;
+}
@@ -0,0 +1,84 @@
+#include "bench.hpp"
+
+#include <ds/crb_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace
+{
+
+// Live bytes requested from the global allocator, allocator overhead
+// excluded.
+std::size_t g_live_bytes = 0;
+
+}
+
+void* operator new(std::size_t size)
+{
+   auto p = std::malloc(size + sizeof(std::max_align_t));
+   if (!p)
+      throw std::bad_alloc();
+   *static_cast<std::size_t*>(p) = size;
+   g_live_bytes += size;
+   return static_cast<char*>(p) + sizeof(std::max_align_t);
+}
+
+void operator delete(void* p) noexcept
+{
+   if (!p)
+      return;
+   auto base = static_cast<char*>(p) - sizeof(std::max_align_t);
+   g_live_bytes -= *reinterpret_cast<std::size_t*>(base);
+   std::free(base);
+}
+
+namespace
+{
+
+template <typename TreeType, typename KeyType>
+void run(const char* name, const std::vector<KeyType>& keys)
+{
+   const auto n = keys.size();
+   std::size_t found = 0;
+   {
+      const auto before = g_live_bytes;
+      TreeType t;
+      for (const auto& k : keys)
+         t.put(k, 0);
+      const auto bytes = g_live_bytes - before;
+
+      const auto ms = bench::time_ms([&] {
+         for (const auto& k : keys)
+            found += t.get(k) != nullptr;
+      });
+      std::printf("%-28s %10zu keys %12zu bytes %8.2f bytes/key\n",
+                  name, n, bytes, static_cast<double>(bytes) / n);
+      bench::report(name, "get", n, ms);
+   }
+   bench::escape(found);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+   const auto keys = bench::shuffled_keys(n);
+
+   run<ds::rb_tree_t<int, int>>("rb_tree_t<int>", keys);
+   run<ds::compact_rb_tree_t<int, int>>("compact_rb_tree_t<int>", keys);
+   run<ds::crb_tree_t<int, int>>("crb_tree_t<int>", keys);
+   run<ds::compact_crb_tree_t<int, int>>("compact_crb_tree_t<int>", keys);
+
+   std::vector<long long> wide_keys(keys.begin(), keys.end());
+   run<ds::rb_tree_t<long long, long long>>("rb_tree_t<long long>",
+                                            wide_keys);
+   run<ds::compact_rb_tree_t<long long, long long>>(
+      "compact_rb_tree_t<long long>", wide_keys);
+
+   return 0;
+}
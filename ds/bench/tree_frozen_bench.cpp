@@ -0,0 +1,65 @@
+#include "bench.hpp"
+
+#include <ds/frozen_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <string>
+
+namespace
+{
+
+// Repeats the probes so that every size performs the same number of
+// lookups.
+template <typename MapType>
+void run_lookups(const std::string& name, const MapType& m,
+                 const std::vector<int>& probes, std::size_t nb_lookups)
+{
+   std::size_t found = 0;
+   std::size_t ranks = 0;
+   bench::report(name.c_str(), "get", nb_lookups, bench::time_ms([&] {
+      for (std::size_t i = 0; i < nb_lookups; ++i)
+         found += m.get(probes[i % probes.size()]) != nullptr;
+      bench::escape(found);
+   }));
+   bench::report(name.c_str(), "rank", nb_lookups, bench::time_ms([&] {
+      for (std::size_t i = 0; i < nb_lookups; ++i)
+         ranks += m.rank(probes[i % probes.size()]);
+      bench::escape(ranks);
+   }));
+}
+
+void run(std::size_t n, std::size_t nb_lookups)
+{
+   // even keys only, half of the probes miss
+   auto keys = bench::shuffled_keys(n);
+   for (auto& k : keys)
+      k *= 2;
+   auto probes = bench::shuffled_keys(2 * n, 7);
+
+   ds::rb_tree_t<int, int> t;
+   for (auto k : keys)
+      t.put(k, k);
+
+   const auto suffix = "/" + std::to_string(n);
+   run_lookups("rb_tree_t" + suffix, t, probes, nb_lookups);
+
+   const auto e = ds::freeze(t);
+   run_lookups("eytzinger" + suffix, e, probes, nb_lookups);
+
+   const auto v = ds::freeze<ds::veb_layout_t>(t);
+   run_lookups("veb" + suffix, v, probes, nb_lookups);
+}
+
+}
+
+// Sizes go from a few KiB of keys, that fit in L1, up to the given largest
+// one, by default well past the last level cache.
+int main(int argc, char** argv)
+{
+   const auto max_n = bench::arg_size(argc, argv, 1, 1 << 22);
+   const auto nb_lookups = bench::arg_size(argc, argv, 2, 1000000);
+
+   for (std::size_t n = 1 << 10; n <= max_n; n <<= 2)
+      run(n, nb_lookups);
+   return 0;
+}
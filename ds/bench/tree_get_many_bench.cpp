@@ -0,0 +1,57 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+
+#include <string>
+
+namespace
+{
+
+// Resolves the probes by batches, as a request handler would.
+void run(std::size_t n, std::size_t batch)
+{
+   const auto keys = bench::shuffled_keys(n);
+   const auto probes = bench::shuffled_keys(n, 7);
+
+   ds::rb_tree_t<int, int> t;
+   for (auto k : keys)
+      t.put(k, k);
+
+   std::vector<int*> values(batch);
+   long long sum = 0;
+   const auto name = "rb_tree_t/" + std::to_string(n);
+
+   bench::report(name.c_str(), "get", probes.size(), bench::time_ms([&] {
+      for (std::size_t i = 0; i < probes.size(); i += batch)
+      {
+         const auto last = std::min(i + batch, probes.size());
+         for (auto j = i; j < last; ++j)
+            values[j - i] = t.get(probes[j]);
+         sum += *values[0];
+      }
+      bench::escape(sum);
+   }));
+
+   bench::report(name.c_str(), "get_many", probes.size(), bench::time_ms([&] {
+      for (std::size_t i = 0; i < probes.size(); i += batch)
+      {
+         const auto last = std::min(i + batch, probes.size());
+         t.get_many(probes.begin() + i, probes.begin() + last,
+                    values.begin());
+         sum += *values[0];
+      }
+      bench::escape(sum);
+   }));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto max_n = bench::arg_size(argc, argv, 1, 1 << 22);
+   const auto batch = bench::arg_size(argc, argv, 2, 256);
+
+   for (std::size_t n = 1 << 12; n <= max_n; n <<= 2)
+      run(n, batch);
+   return 0;
+}
@@ -0,0 +1,69 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+
+#include <string>
+
+namespace
+{
+
+using tree_t = ds::rb_tree_t<int, std::string>;
+
+const std::size_t payload_size = 256;
+
+void run(const std::vector<int>& keys)
+{
+   const auto n = keys.size();
+   const std::string payload(payload_size, 'x');
+
+   {
+      tree_t t;
+      bench::report("put/copy", "insert", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.put(k, payload);
+      }));
+      bench::report("put/copy", "overwrite", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.put(k, payload);
+      }));
+   }
+
+   {
+      std::vector<std::string> values(n, payload);
+      std::vector<std::string> updates(n, payload);
+      tree_t t;
+      bench::report("put/move", "insert", n, bench::time_ms([&] {
+         for (std::size_t i = 0; i < n; ++i)
+            t.put(keys[i], std::move(values[i]));
+      }));
+      bench::report("put/move", "overwrite", n, bench::time_ms([&] {
+         for (std::size_t i = 0; i < n; ++i)
+            t.put(keys[i], std::move(updates[i]));
+      }));
+      bench::report("put/move", "remove", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.remove(k);
+      }));
+   }
+
+   {
+      tree_t t;
+      bench::report("try_emplace", "insert", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.try_emplace(k, payload_size, 'x');
+      }));
+      bench::report("try_emplace", "present", n, bench::time_ms([&] {
+         for (auto k : keys)
+            t.try_emplace(k, payload_size, 'x');
+      }));
+   }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 500000);
+   run(bench::shuffled_keys(n));
+   return 0;
+}
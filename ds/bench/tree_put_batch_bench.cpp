@@ -0,0 +1,82 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+template <typename ValueType>
+using tree_t = ds::rb_tree_t<int, ValueType>;
+
+// The even keys below 2 n.
+template <typename ValueType>
+tree_t<ValueType> make_tree(std::size_t n, const ValueType& value)
+{
+   std::vector<std::pair<int, ValueType>> kvs;
+   kvs.reserve(n);
+   for (std::size_t i = 0; i < n; ++i)
+      kvs.emplace_back(static_cast<int>(2 * i), value);
+   return tree_t<ValueType>(kvs.begin(), kvs.end());
+}
+
+// m random keys below 2 n, half of which are in the tree.
+template <typename ValueType>
+std::vector<std::pair<int, ValueType>> make_batch(std::size_t n,
+                                                  std::size_t m,
+                                                  const ValueType& value)
+{
+   auto keys = bench::shuffled_keys(2 * n, 7);
+   keys.resize(m);
+   std::vector<std::pair<int, ValueType>> batch;
+   batch.reserve(m);
+   for (auto k : keys)
+      batch.emplace_back(k, value);
+   return batch;
+}
+
+template <typename ValueType>
+void run(const std::string& name, std::size_t n, std::size_t m,
+         const ValueType& old_value, const ValueType& new_value)
+{
+   const auto label =
+      name + "/" + std::to_string(n) + "+" + std::to_string(m);
+   const auto batch = make_batch(n, m, new_value);
+   {
+      auto t = make_tree(n, old_value);
+      bench::report(("put/" + label).c_str(), "update", m,
+                    bench::time_ms([&] {
+         for (const auto& kv : batch)
+            t.put(kv.first, kv.second);
+         bench::escape(t);
+      }));
+   }
+   {
+      auto t = make_tree(n, old_value);
+      bench::report(("put_batch/" + label).c_str(), "update", m,
+                    bench::time_ms([&] {
+         t.put_batch(batch.begin(), batch.end());
+         bench::escape(t);
+      }));
+   }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 20);
+
+   for (auto m = std::max<std::size_t>(1, n / 1024); m <= n; m *= 4)
+      run("int", n, m, 0, 1);
+   // heap-allocated payloads, which the rebuild must not copy
+   const std::string old_payload(64, 'a');
+   const std::string new_payload(64, 'b');
+   for (auto m = std::max<std::size_t>(1, n / 16); m <= n; m *= 4)
+      run("string", n, m, old_payload, new_payload);
+   return 0;
+}
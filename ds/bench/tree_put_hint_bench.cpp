@@ -0,0 +1,91 @@
+#include "bench.hpp"
+
+#include <ds/crb_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace
+{
+
+std::size_t nb_comparisons = 0;
+
+struct counting_less_t
+{
+   bool operator()(int a, int b) const
+   {
+      ++nb_comparisons;
+      return a < b;
+   }
+};
+
+// Sorted keys, each moved by up to window places.
+std::vector<int> nearly_sorted_keys(std::size_t n, std::size_t window)
+{
+   std::vector<int> keys(n);
+   for (std::size_t i = 0; i < n; ++i)
+      keys[i] = static_cast<int>(i);
+   std::mt19937 gen(42);
+   for (std::size_t i = 0; i + window < n; i += window)
+      std::shuffle(keys.begin() + i, keys.begin() + i + window, gen);
+   return keys;
+}
+
+template <typename TreeType>
+void run(const std::string& name, const std::vector<int>& keys)
+{
+   const auto n = keys.size();
+   {
+      TreeType t;
+      nb_comparisons = 0;
+      bench::report((name + "/put").c_str(), "insert", n,
+                    bench::time_ms([&] {
+         for (auto k : keys)
+            t.put(k, k);
+         bench::escape(t);
+      }));
+      std::printf("%-24s %-12s %10.2f comparisons/op\n",
+                  (name + "/put").c_str(), "insert",
+                  double(nb_comparisons) / n);
+   }
+   {
+      TreeType t;
+      nb_comparisons = 0;
+      bench::report((name + "/put_hint").c_str(), "insert", n,
+                    bench::time_ms([&] {
+         auto hint = t.end();
+         for (auto k : keys)
+            hint = t.put_hint(hint, k, k);
+         bench::escape(t);
+      }));
+      std::printf("%-24s %-12s %10.2f comparisons/op\n",
+                  (name + "/put_hint").c_str(), "insert",
+                  double(nb_comparisons) / n);
+   }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+
+   std::vector<int> sorted(n);
+   for (std::size_t i = 0; i < n; ++i)
+      sorted[i] = static_cast<int>(i);
+   const auto nearly_sorted = nearly_sorted_keys(n, 8);
+   const auto random = bench::shuffled_keys(n);
+
+   using rb_t = ds::rb_tree_t<int, int, counting_less_t>;
+   using crb_t = ds::crb_tree_t<int, int, counting_less_t>;
+   run<rb_t>("rb/sorted", sorted);
+   run<rb_t>("rb/nearly", nearly_sorted);
+   run<rb_t>("rb/random", random);
+   run<crb_t>("crb/sorted", sorted);
+   run<crb_t>("crb/nearly", nearly_sorted);
+   run<crb_t>("crb/random", random);
+   return 0;
+}
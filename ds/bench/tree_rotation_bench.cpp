@@ -0,0 +1,58 @@
+#define DS_TREE_STATS
+
+#include "bench.hpp"
+
+#include <ds/crb_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <cstdio>
+
+namespace
+{
+
+std::size_t rotations()
+{
+   return ds::detail::tree_stats_t::rotations().load(
+      std::memory_order_relaxed);
+}
+
+template <typename TreeType>
+void run(const char* name, const std::vector<int>& keys)
+{
+   const auto n = keys.size();
+   TreeType t;
+
+   auto r = rotations();
+   bench::report(name, "insert", n, bench::time_ms([&] {
+      for (auto k : keys)
+         t.put(k, k);
+   }));
+   std::printf("%-24s %-12s %10.3f rotations/op\n", name, "insert",
+               double(rotations() - r) / n);
+
+   r = rotations();
+   bench::report(name, "remove", n, bench::time_ms([&] {
+      for (auto k : keys)
+         t.remove(k);
+   }));
+   std::printf("%-24s %-12s %10.3f rotations/op\n", name, "remove",
+               double(rotations() - r) / n);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1000000);
+   const auto keys = bench::shuffled_keys(n);
+
+   std::vector<int> sorted(keys);
+   std::sort(sorted.begin(), sorted.end());
+
+   run<ds::rb_tree_t<int, int>>("rb_tree_t/random", keys);
+   run<ds::crb_tree_t<int, int>>("crb_tree_t/random", keys);
+   run<ds::rb_tree_t<int, int>>("rb_tree_t/sorted", sorted);
+   run<ds::crb_tree_t<int, int>>("crb_tree_t/sorted", sorted);
+
+   return 0;
+}
@@ -0,0 +1,77 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using tree_t = ds::rb_tree_t<int, int>;
+
+// The even keys below 2 n.
+tree_t make_master(std::size_t n)
+{
+   std::vector<std::pair<int, int>> kvs;
+   kvs.reserve(n);
+   for (std::size_t i = 0; i < n; ++i)
+      kvs.emplace_back(static_cast<int>(2 * i), 0);
+   return tree_t(kvs.begin(), kvs.end());
+}
+
+// m random keys below 2 n, half of which are in the master.
+tree_t make_delta(std::size_t n, std::size_t m)
+{
+   auto keys = bench::shuffled_keys(2 * n, 7);
+   keys.resize(m);
+   std::sort(keys.begin(), keys.end());
+   std::vector<std::pair<int, int>> kvs;
+   kvs.reserve(m);
+   for (auto k : keys)
+      kvs.emplace_back(k, 1);
+   return tree_t(kvs.begin(), kvs.end());
+}
+
+// Merges a delta of m keys into a master tree of n keys.
+void run(std::size_t n, std::size_t m, std::size_t nb_threads)
+{
+   const auto label = std::to_string(n) + "+" + std::to_string(m);
+   {
+      auto master = make_master(n);
+      auto delta = make_delta(n, m);
+      bench::report(("put/" + label).c_str(), "merge", m,
+                    bench::time_ms([&] {
+         for (const auto& kv : delta)
+            master.put(kv.first, kv.second);
+         bench::escape(master);
+      }));
+   }
+
+   for (std::size_t t = 1; t <= nb_threads; t *= 2)
+   {
+      auto master = make_master(n);
+      auto delta = make_delta(n, m);
+      const auto name = "set_union/" + std::to_string(t) + "/" + label;
+      bench::report(name.c_str(), "merge", m, bench::time_ms([&] {
+         master = ds::set_union(std::move(master), std::move(delta), t);
+         bench::escape(master);
+      }));
+   }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto n = bench::arg_size(argc, argv, 1, 1 << 22);
+   const auto nb_threads = bench::arg_size(
+      argc, argv, 2, std::max(1u, std::thread::hardware_concurrency()));
+
+   for (std::size_t m = n / 1000; m <= n; m *= 10)
+      run(n, m, nb_threads);
+   return 0;
+}
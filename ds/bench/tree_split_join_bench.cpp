@@ -0,0 +1,72 @@
+#include "bench.hpp"
+
+#include <ds/rb_tree.hpp>
+
+#include <string>
+
+namespace
+{
+
+using tree_t = ds::rb_tree_t<int, int>;
+
+tree_t make_tree(std::size_t n)
+{
+   tree_t t;
+   for (auto k : bench::shuffled_keys(n))
+      t.put(k, k);
+   return t;
+}
+
+// Hands the upper half of a tree of n keys over to another tree, then
+// gives it back, nb_rounds times.
+void run_copy(std::size_t n, std::size_t nb_rounds)
+{
+   auto t = make_tree(n);
+   const auto mid = static_cast<int>(n / 2);
+   const auto label = "copy/" + std::to_string(n);
+   bench::report(label.c_str(), "move half", 2 * nb_rounds,
+                 bench::time_ms([&] {
+      for (std::size_t r = 0; r < nb_rounds; ++r)
+      {
+         tree_t right;
+         for (const auto& kv : t.range(mid, static_cast<int>(n)))
+            right.put(kv.first, kv.second);
+         for (int k = mid; k < static_cast<int>(n); ++k)
+            t.remove(k);
+
+         for (const auto& kv : right)
+            t.put(kv.first, kv.second);
+         bench::escape(t);
+      }
+   }));
+}
+
+void run_split_join(std::size_t n, std::size_t nb_rounds)
+{
+   auto t = make_tree(n);
+   const auto mid = static_cast<int>(n / 2);
+   const auto label = "split_join/" + std::to_string(n);
+   bench::report(label.c_str(), "move half", 2 * nb_rounds,
+                 bench::time_ms([&] {
+      for (std::size_t r = 0; r < nb_rounds; ++r)
+      {
+         auto right = t.split(mid);
+         t.join(right);
+         bench::escape(t);
+      }
+   }));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+   const auto max_n = bench::arg_size(argc, argv, 1, 1 << 20);
+
+   for (std::size_t n = 1 << 10; n <= max_n; n *= 8)
+   {
+      run_copy(n, std::max<std::size_t>(1, (1 << 16) / n));
+      run_split_join(n, 10000);
+   }
+   return 0;
+}
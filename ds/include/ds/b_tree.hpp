@@ -0,0 +1,726 @@
+#ifndef DATASTRUCTURES_B_TREE_HPP
+#define DATASTRUCTURES_B_TREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ds/simd_search.hpp"
+#include "ds/tree.hpp"
+
+namespace ds
+{
+
+namespace detail
+{
+
+// Default fanout: the keys of a node span four cache lines.
+template <typename KeyType>
+constexpr std::size_t b_tree_fanout()
+{
+   return 256 / sizeof(KeyType) < 8 ? 8 : 256 / sizeof(KeyType);
+}
+
+// Search among the n sorted keys of a node.
+template <typename KeyType, typename LessType, typename = void>
+struct b_tree_search_t
+{
+   // Index of the first key not less than key.
+   static std::size_t lower_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType& less)
+   {
+      std::size_t lo = 0;
+      while (n > 0)
+      {
+         const auto half = n / 2;
+         if (less(keys[lo + half], key))
+         {
+            lo += half + 1;
+            n -= half + 1;
+         }
+         else
+         {
+            n = half;
+         }
+      }
+      return lo;
+   }
+
+   // Index of the first key greater than key.
+   static std::size_t upper_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType& less)
+   {
+      std::size_t lo = 0;
+      while (n > 0)
+      {
+         const auto half = n / 2;
+         if (!less(key, keys[lo + half]))
+         {
+            lo += half + 1;
+            n -= half + 1;
+         }
+         else
+         {
+            n = half;
+         }
+      }
+      return lo;
+   }
+};
+
+// Integer keys ordered by std::less are searched with vector compares.
+template <typename KeyType, typename LessType>
+struct b_tree_search_t<
+   KeyType, LessType,
+   typename std::enable_if<
+      simd_search_t<KeyType>::enabled &&
+      std::is_same<LessType, std::less<KeyType>>::value>::type>
+{
+   static std::size_t lower_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType&)
+   {
+      return simd_search_t<KeyType>::count_less(keys, n, key);
+   }
+
+   static std::size_t upper_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType&)
+   {
+      return simd_search_t<KeyType>::count_less_equal(keys, n, key);
+   }
+};
+
+// Fixed capacity storage for elements that need not be default
+// constructible. Only the first n elements are alive, n being kept by the
+// owner and passed along.
+template <typename T, std::size_t N>
+struct slots_t
+{
+   T* data() { return reinterpret_cast<T*>(m_storage); }
+
+   const T* data() const { return reinterpret_cast<const T*>(m_storage); }
+
+   T& operator[](std::size_t i) { return data()[i]; }
+
+   const T& operator[](std::size_t i) const { return data()[i]; }
+
+   // Constructs an element at position i out of args.
+   template <typename... Args>
+   void insert(std::size_t n, std::size_t i, Args&&... args)
+   {
+      auto a = data();
+      if (i == n)
+      {
+         new (a + n) T(std::forward<Args>(args)...);
+         return;
+      }
+
+      T tmp(std::forward<Args>(args)...);
+      new (a + n) T(std::move(a[n - 1]));
+      std::move_backward(a + i, a + n - 1, a + n);
+      a[i] = std::move(tmp);
+   }
+
+   void erase(std::size_t n, std::size_t i)
+   {
+      auto a = data();
+      std::move(a + i + 1, a + n, a + i);
+      a[n - 1].~T();
+   }
+
+   // Moves the elements [first, last) after the n elements of dst.
+   void move_to(std::size_t first, std::size_t last,
+                slots_t& dst, std::size_t n)
+   {
+      auto a = data();
+      auto d = dst.data() + n;
+      for (auto i = first; i < last; ++i, ++d)
+      {
+         new (d) T(std::move(a[i]));
+         a[i].~T();
+      }
+   }
+
+   void destroy(std::size_t first, std::size_t last)
+   {
+      auto a = data();
+      for (auto i = first; i < last; ++i)
+         a[i].~T();
+   }
+
+   typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage[N];
+};
+
+template <typename KeyType, std::size_t Fanout>
+struct b_node_t
+{
+   explicit b_node_t(bool leaf):
+      m_leaf(leaf)
+   {}
+
+   ~b_node_t()
+   {
+      m_keys.destroy(0, m_size);
+   }
+
+   std::size_t m_size = 0;
+   bool m_leaf;
+   slots_t<KeyType, Fanout> m_keys;
+};
+
+// Inner node: m_size separator keys and m_size + 1 children, the keys of
+// child i being not less than key i - 1 and less than key i.
+template <typename KeyType, std::size_t Fanout>
+struct b_inner_t: public b_node_t<KeyType, Fanout>
+{
+   b_inner_t():
+      b_node_t<KeyType, Fanout>(false)
+   {}
+
+   b_node_t<KeyType, Fanout>* m_children[Fanout + 1];
+};
+
+// Leaf node: m_size (key, value) pairs, chained in key order.
+template <typename KeyType, typename ValueType, std::size_t Fanout>
+struct b_leaf_t: public b_node_t<KeyType, Fanout>
+{
+   using key_t = KeyType;
+   using value_t = ValueType;
+
+   b_leaf_t():
+      b_node_t<KeyType, Fanout>(true)
+   {}
+
+   ~b_leaf_t()
+   {
+      m_values.destroy(0, this->m_size);
+   }
+
+   slots_t<ValueType, Fanout> m_values;
+   b_leaf_t* m_next = nullptr;
+};
+
+// Forward in-order iterator over the leaf chain. Dereferencing yields a pair
+// of references to the key and the value.
+template <typename LeafType, bool IsConst>
+class b_tree_iterator_t
+{
+   using key_t = typename LeafType::key_t;
+   using mapped_t = typename LeafType::value_t;
+
+public:
+   using iterator_category = std::forward_iterator_tag;
+   using value_type = std::pair<const key_t, mapped_t>;
+   using difference_type = std::ptrdiff_t;
+   using reference =
+      std::pair<const key_t&,
+                typename std::conditional<IsConst, const mapped_t&,
+                                          mapped_t&>::type>;
+   using pointer = arrow_proxy_t<reference>;
+
+   b_tree_iterator_t() = default;
+
+   b_tree_iterator_t(LeafType* leaf, std::size_t pos):
+      m_leaf(leaf),
+      m_pos(pos)
+   {}
+
+   template <bool WasConst,
+             typename = typename std::enable_if<IsConst && !WasConst>::type>
+   b_tree_iterator_t(const b_tree_iterator_t<LeafType, WasConst>& other):
+      m_leaf(other.leaf()),
+      m_pos(other.pos())
+   {}
+
+   reference operator*() const
+   {
+      return reference(m_leaf->m_keys[m_pos], m_leaf->m_values[m_pos]);
+   }
+
+   pointer operator->() const
+   {
+      return pointer{**this};
+   }
+
+   b_tree_iterator_t& operator++()
+   {
+      if (++m_pos == m_leaf->m_size)
+      {
+         m_leaf = m_leaf->m_next;
+         m_pos = 0;
+      }
+      return *this;
+   }
+
+   b_tree_iterator_t operator++(int)
+   {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+   }
+
+   friend bool operator==(const b_tree_iterator_t& lhs,
+                          const b_tree_iterator_t& rhs)
+   {
+      return lhs.m_leaf == rhs.m_leaf && lhs.m_pos == rhs.m_pos;
+   }
+
+   friend bool operator!=(const b_tree_iterator_t& lhs,
+                          const b_tree_iterator_t& rhs)
+   {
+      return !(lhs == rhs);
+   }
+
+   LeafType* leaf() const { return m_leaf; }
+
+   std::size_t pos() const { return m_pos; }
+
+private:
+   LeafType* m_leaf = nullptr;
+   std::size_t m_pos = 0;
+};
+
+}
+
+// B+ tree map: up to Fanout sorted keys per node, values in the leaves only,
+// leaves chained for scans. Nodes are split on the way down on insertion
+// and refilled on the way down on removal, so both run in a single pass.
+template <typename KeyType, typename ValueType,
+          typename LessType = std::less<KeyType>,
+          std::size_t Fanout = detail::b_tree_fanout<KeyType>()>
+class b_tree_t
+{
+   static_assert(Fanout >= 4, "b_tree_t needs a fanout of at least 4");
+
+   using node_t = detail::b_node_t<KeyType, Fanout>;
+   using inner_t = detail::b_inner_t<KeyType, Fanout>;
+   using leaf_t = detail::b_leaf_t<KeyType, ValueType, Fanout>;
+   using search_t = detail::b_tree_search_t<KeyType, LessType>;
+
+   // Fewest keys a node other than the root holds.
+   static constexpr std::size_t min_keys = (Fanout - 1) / 2;
+
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using iterator = detail::b_tree_iterator_t<leaf_t, false>;
+   using const_iterator = detail::b_tree_iterator_t<leaf_t, true>;
+
+   b_tree_t(const LessType& less):
+      m_less(less)
+   {}
+
+   b_tree_t() = default;
+
+   ~b_tree_t()
+   {
+      clear();
+   }
+
+   b_tree_t(b_tree_t&& other):
+      m_root(other.m_root),
+      m_size(other.m_size),
+      m_less(std::move(other.m_less))
+   {
+      other.m_root = nullptr;
+      other.m_size = 0;
+   }
+
+   b_tree_t& operator=(b_tree_t&& other)
+   {
+      if (this == &other)
+         return *this;
+
+      clear();
+      m_root = other.m_root;
+      m_size = other.m_size;
+      m_less = std::move(other.m_less);
+      other.m_root = nullptr;
+      other.m_size = 0;
+      return *this;
+   }
+
+   template <typename ValueArgType>
+   void put(const key_t& key, ValueArgType&& value)
+   {
+      _put(key, std::forward<ValueArgType>(value));
+   }
+
+   template <typename ValueArgType>
+   void put(key_t&& key, ValueArgType&& value)
+   {
+      _put(std::move(key), std::forward<ValueArgType>(value));
+   }
+
+   value_t* get(const key_t& key) const
+   {
+      auto leaf = find_leaf(key);
+      if (!leaf)
+         return nullptr;
+
+      const auto i = search_t::lower_bound(leaf->m_keys.data(), leaf->m_size,
+                                           key, m_less);
+      if (i == leaf->m_size || m_less(key, leaf->m_keys[i]))
+         return nullptr;
+      return &leaf->m_values[i];
+   }
+
+   void remove(const key_t& key)
+   {
+      if (!m_root)
+         return;
+
+      auto node = m_root;
+      while (!node->m_leaf)
+      {
+         auto inner = static_cast<inner_t*>(node);
+         auto i = search_t::upper_bound(inner->m_keys.data(), inner->m_size,
+                                        key, m_less);
+         if (inner->m_children[i]->m_size <= min_keys)
+            i = refill_child(inner, i);
+         node = inner->m_children[i];
+
+         if (inner == m_root && inner->m_size == 0)
+         {
+            m_root = node;
+            delete inner;
+         }
+      }
+
+      auto leaf = static_cast<leaf_t*>(node);
+      const auto i = search_t::lower_bound(leaf->m_keys.data(), leaf->m_size,
+                                           key, m_less);
+      if (i < leaf->m_size && !m_less(key, leaf->m_keys[i]))
+      {
+         leaf->m_keys.erase(leaf->m_size, i);
+         leaf->m_values.erase(leaf->m_size, i);
+         --leaf->m_size;
+         --m_size;
+      }
+
+      if (m_root->m_size == 0)
+      {
+         delete static_cast<leaf_t*>(m_root);
+         m_root = nullptr;
+      }
+   }
+
+   std::size_t size() const
+   {
+      return m_size;
+   }
+
+   void clear()
+   {
+      destroy(m_root);
+      m_root = nullptr;
+      m_size = 0;
+   }
+
+   iterator begin() { return iterator(first_leaf(), 0); }
+
+   iterator end() { return iterator(); }
+
+   const_iterator begin() const { return const_iterator(first_leaf(), 0); }
+
+   const_iterator end() const { return const_iterator(); }
+
+   // First element whose key is not less than key.
+   iterator lower_bound(const key_t& key)
+   {
+      return _lower_bound<iterator>(key);
+   }
+
+   const_iterator lower_bound(const key_t& key) const
+   {
+      return _lower_bound<const_iterator>(key);
+   }
+
+private:
+   node_t* m_root = nullptr;
+   std::size_t m_size = 0;
+   LessType m_less;
+
+   template <typename KeyArgType, typename ValueArgType>
+   void _put(KeyArgType&& key, ValueArgType&& value)
+   {
+      if (!m_root)
+         m_root = new leaf_t();
+
+      if (m_root->m_size == Fanout)
+      {
+         auto root = new inner_t();
+         root->m_children[0] = m_root;
+         m_root = root;
+         split_child(root, 0);
+      }
+
+      auto node = m_root;
+      while (!node->m_leaf)
+      {
+         auto inner = static_cast<inner_t*>(node);
+         auto i = search_t::upper_bound(inner->m_keys.data(), inner->m_size,
+                                        key, m_less);
+         if (inner->m_children[i]->m_size == Fanout)
+         {
+            split_child(inner, i);
+            if (!m_less(key, inner->m_keys[i]))
+               ++i;
+         }
+         node = inner->m_children[i];
+      }
+
+      auto leaf = static_cast<leaf_t*>(node);
+      const auto n = leaf->m_size;
+      const auto i = search_t::lower_bound(leaf->m_keys.data(), n, key,
+                                           m_less);
+      if (i < n && !m_less(key, leaf->m_keys[i]))
+      {
+         leaf->m_values[i] = std::forward<ValueArgType>(value);
+         return;
+      }
+
+      leaf->m_values.insert(n, i, std::forward<ValueArgType>(value));
+      try
+      {
+         leaf->m_keys.insert(n, i, std::forward<KeyArgType>(key));
+      }
+      catch (...)
+      {
+         leaf->m_values.erase(n + 1, i);
+         throw;
+      }
+      ++leaf->m_size;
+      ++m_size;
+   }
+
+   leaf_t* find_leaf(const key_t& key) const
+   {
+      auto node = m_root;
+      if (!node)
+         return nullptr;
+
+      while (!node->m_leaf)
+      {
+         auto inner = static_cast<inner_t*>(node);
+         node = inner->m_children[
+            search_t::upper_bound(inner->m_keys.data(), inner->m_size, key,
+                                  m_less)];
+      }
+      return static_cast<leaf_t*>(node);
+   }
+
+   leaf_t* first_leaf() const
+   {
+      auto node = m_root;
+      if (!node)
+         return nullptr;
+
+      while (!node->m_leaf)
+         node = static_cast<inner_t*>(node)->m_children[0];
+      return static_cast<leaf_t*>(node);
+   }
+
+   template <typename IteratorType>
+   IteratorType _lower_bound(const key_t& key) const
+   {
+      auto leaf = find_leaf(key);
+      if (!leaf)
+         return IteratorType();
+
+      const auto i = search_t::lower_bound(leaf->m_keys.data(), leaf->m_size,
+                                           key, m_less);
+      if (i == leaf->m_size)
+         return IteratorType(leaf->m_next, 0);
+      return IteratorType(leaf, i);
+   }
+
+   // Splits the full child i of a non full parent in two halves.
+   static void split_child(inner_t* parent, std::size_t i)
+   {
+      const auto h = Fanout / 2;
+      node_t* right = nullptr;
+      if (parent->m_children[i]->m_leaf)
+      {
+         auto left = static_cast<leaf_t*>(parent->m_children[i]);
+         auto r = new leaf_t();
+         left->m_keys.move_to(h, Fanout, r->m_keys, 0);
+         left->m_values.move_to(h, Fanout, r->m_values, 0);
+         left->m_size = h;
+         r->m_size = Fanout - h;
+         r->m_next = left->m_next;
+         left->m_next = r;
+         parent->m_keys.insert(parent->m_size, i, r->m_keys[0]);
+         right = r;
+      }
+      else
+      {
+         auto left = static_cast<inner_t*>(parent->m_children[i]);
+         auto r = new inner_t();
+         left->m_keys.move_to(h + 1, Fanout, r->m_keys, 0);
+         std::copy(left->m_children + h + 1, left->m_children + Fanout + 1,
+                   r->m_children);
+         r->m_size = Fanout - h - 1;
+         parent->m_keys.insert(parent->m_size, i, std::move(left->m_keys[h]));
+         left->m_keys.destroy(h, h + 1);
+         left->m_size = h;
+         right = r;
+      }
+
+      std::copy_backward(parent->m_children + i + 1,
+                         parent->m_children + parent->m_size + 1,
+                         parent->m_children + parent->m_size + 2);
+      parent->m_children[i + 1] = right;
+      ++parent->m_size;
+   }
+
+   // Brings child i of parent above min_keys by borrowing from a sibling or
+   // merging with one. Returns the index of the child holding its keys.
+   static std::size_t refill_child(inner_t* parent, std::size_t i)
+   {
+      if (i > 0 && parent->m_children[i - 1]->m_size > min_keys)
+      {
+         borrow_from_left(parent, i);
+         return i;
+      }
+      if (i < parent->m_size && parent->m_children[i + 1]->m_size > min_keys)
+      {
+         borrow_from_right(parent, i);
+         return i;
+      }
+      if (i < parent->m_size)
+      {
+         merge_children(parent, i);
+         return i;
+      }
+      merge_children(parent, i - 1);
+      return i - 1;
+   }
+
+   static void borrow_from_left(inner_t* parent, std::size_t i)
+   {
+      auto node = parent->m_children[i];
+      auto sibling = parent->m_children[i - 1];
+      const auto last = sibling->m_size - 1;
+      if (node->m_leaf)
+      {
+         auto leaf = static_cast<leaf_t*>(node);
+         auto left = static_cast<leaf_t*>(sibling);
+         leaf->m_keys.insert(leaf->m_size, 0, std::move(left->m_keys[last]));
+         leaf->m_values.insert(leaf->m_size, 0,
+                               std::move(left->m_values[last]));
+         left->m_keys.destroy(last, last + 1);
+         left->m_values.destroy(last, last + 1);
+         parent->m_keys[i - 1] = leaf->m_keys[0];
+      }
+      else
+      {
+         auto inner = static_cast<inner_t*>(node);
+         auto left = static_cast<inner_t*>(sibling);
+         inner->m_keys.insert(inner->m_size, 0,
+                              std::move(parent->m_keys[i - 1]));
+         std::copy_backward(inner->m_children,
+                            inner->m_children + inner->m_size + 1,
+                            inner->m_children + inner->m_size + 2);
+         inner->m_children[0] = left->m_children[last + 1];
+         parent->m_keys[i - 1] = std::move(left->m_keys[last]);
+         left->m_keys.destroy(last, last + 1);
+      }
+      --sibling->m_size;
+      ++node->m_size;
+   }
+
+   static void borrow_from_right(inner_t* parent, std::size_t i)
+   {
+      auto node = parent->m_children[i];
+      auto sibling = parent->m_children[i + 1];
+      const auto n = node->m_size;
+      if (node->m_leaf)
+      {
+         auto leaf = static_cast<leaf_t*>(node);
+         auto right = static_cast<leaf_t*>(sibling);
+         leaf->m_keys.insert(n, n, std::move(right->m_keys[0]));
+         leaf->m_values.insert(n, n, std::move(right->m_values[0]));
+         right->m_keys.erase(right->m_size, 0);
+         right->m_values.erase(right->m_size, 0);
+         parent->m_keys[i] = right->m_keys[0];
+      }
+      else
+      {
+         auto inner = static_cast<inner_t*>(node);
+         auto right = static_cast<inner_t*>(sibling);
+         inner->m_keys.insert(n, n, std::move(parent->m_keys[i]));
+         inner->m_children[n + 1] = right->m_children[0];
+         parent->m_keys[i] = std::move(right->m_keys[0]);
+         right->m_keys.erase(right->m_size, 0);
+         std::copy(right->m_children + 1,
+                   right->m_children + right->m_size + 1,
+                   right->m_children);
+      }
+      --sibling->m_size;
+      ++node->m_size;
+   }
+
+   // Merges child i + 1 of parent into child i.
+   static void merge_children(inner_t* parent, std::size_t i)
+   {
+      auto node = parent->m_children[i];
+      auto sibling = parent->m_children[i + 1];
+      if (node->m_leaf)
+      {
+         auto leaf = static_cast<leaf_t*>(node);
+         auto right = static_cast<leaf_t*>(sibling);
+         right->m_keys.move_to(0, right->m_size, leaf->m_keys, leaf->m_size);
+         right->m_values.move_to(0, right->m_size, leaf->m_values,
+                                 leaf->m_size);
+         leaf->m_size += right->m_size;
+         leaf->m_next = right->m_next;
+         right->m_size = 0;
+         delete right;
+      }
+      else
+      {
+         auto inner = static_cast<inner_t*>(node);
+         auto right = static_cast<inner_t*>(sibling);
+         inner->m_keys.insert(inner->m_size, inner->m_size,
+                              std::move(parent->m_keys[i]));
+         ++inner->m_size;
+         right->m_keys.move_to(0, right->m_size, inner->m_keys, inner->m_size);
+         std::copy(right->m_children, right->m_children + right->m_size + 1,
+                   inner->m_children + inner->m_size);
+         inner->m_size += right->m_size;
+         right->m_size = 0;
+         delete right;
+      }
+
+      parent->m_keys.erase(parent->m_size, i);
+      std::copy(parent->m_children + i + 2,
+                parent->m_children + parent->m_size + 1,
+                parent->m_children + i + 1);
+      --parent->m_size;
+   }
+
+   static void destroy(node_t* node)
+   {
+      if (!node)
+         return;
+
+      if (node->m_leaf)
+      {
+         delete static_cast<leaf_t*>(node);
+         return;
+      }
+
+      auto inner = static_cast<inner_t*>(node);
+      for (std::size_t i = 0; i <= inner->m_size; ++i)
+         destroy(inner->m_children[i]);
+      delete inner;
+   }
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef DATASTRUCTURES_BS_TREE_HPP
 #define DATASTRUCTURES_BS_TREE_HPP
 
+#include <cstddef>
 #include <functional>
 #include <utility>
 
@@ -18,55 +19,131 @@ struct bst_impl_t
    using node_ptr_t = typename node_trait_t<NodeType>::ptr_t;
    using key_t = typename node_trait_t<NodeType>::key_t;
    using value_t = typename node_trait_t<NodeType>::value_t;
+   using arena_t =
+      typename NodeType::alloc_t::template arena_t<NodeType>;
 
    bst_impl_t(const LessType& less):
       m_less(less)
    {}
 
-   void put(node_ptr_t& root, const key_t& key, const value_t& value) const
+   // Creates a node out of key and args unless the key is already present.
+   // Returns the node holding the key and whether it was created.
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<NodeType*, bool> emplace(arena_t& arena, node_ptr_t& root,
+                                      KeyArgType&& key,
+                                      ArgTypes&&... args) const
    {
-      _put(root.get(), root, key, value);
+      NodeType* parent = nullptr;
+      auto slot = &root;
+      while (*slot)
+      {
+         const auto node = slot->get();
+         if (m_less(key, node->m_key))
+         {
+            slot = &node->m_left;
+         }
+         else if (m_less(node->m_key, key))
+         {
+            slot = &node->m_right;
+         }
+         else
+         {
+            return std::make_pair(node, false);
+         }
+         parent = node;
+      }
+
+      return std::make_pair(emplace_at(arena, root, parent, *slot,
+                                       std::forward<KeyArgType>(key),
+                                       std::forward<ArgTypes>(args)...),
+                            true);
    }
 
-   void remove(node_ptr_t& node, const key_t& key) const
+   // Creates a node out of key and args in link, the empty link of parent
+   // where the key belongs, and returns it.
+   template <typename KeyArgType, typename... ArgTypes>
+   static NodeType* emplace_at(arena_t& arena, node_ptr_t&, NodeType* parent,
+                               node_ptr_t& link, KeyArgType&& key,
+                               ArgTypes&&... args)
    {
-      if (!node)
-         return;
+      link = node_ptr_t(arena.create(parent, std::forward<KeyArgType>(key),
+                                     std::forward<ArgTypes>(args)...));
+      for (auto p = parent; p; p = p->parent())
+         ++p->m_count;
+      return link.get();
+   }
 
-      if (m_less(key, node->m_key))
-         remove(node->m_left, key);
-      else if (m_less(node->m_key, key))
-         remove(node->m_right, key);
-      else
-         remove_node(node);
+   // Returns true when a node with the given key was found and removed.
+   template <typename KeyArgType>
+   bool remove(node_ptr_t& root, const KeyArgType& key) const
+   {
+      auto slot = &root;
+      while (*slot)
+      {
+         const auto node = slot->get();
+         if (m_less(key, node->m_key))
+            slot = &node->m_left;
+         else if (m_less(node->m_key, key))
+            slot = &node->m_right;
+         else
+            break;
+      }
+
+      if (!*slot)
+         return false;
+
+      const auto parent = (*slot)->parent();
+      remove_node(*slot);
+      for (auto p = parent; p; p = p->parent())
+         --p->m_count;
+      return true;
+   }
+
+   // Builds a perfectly balanced tree out of n sorted elements, allocating
+   // the nodes in key order.
+   template <typename IteratorType>
+   static node_ptr_t build(arena_t& arena, IteratorType& it, std::size_t n)
+   {
+      if (n == 0)
+         return node_ptr_t();
+
+      auto left = build(arena, it, n / 2);
+      auto node = make_node(arena, it);
+      auto right = build(arena, it, n - n / 2 - 1);
+
+      node->m_left = std::move(left);
+      node->m_right = std::move(right);
+      if (node->m_left)
+         node->m_left->set_parent(node.get());
+      if (node->m_right)
+         node->m_right->set_parent(node.get());
+      node->m_count = n;
+      return node;
    }
 
 private:
    LessType m_less;
 
-   void _put(NodeType* parent, node_ptr_t& node, const key_t& key, 
-            const value_t& value) const
+   template <typename IteratorType>
+   static node_ptr_t make_node(arena_t& arena, IteratorType& it)
    {
-      if (!node)
-      {
-         node = node_ptr_t(new NodeType(parent, key, value));
-      }
-      else if (m_less(key, node->m_key))
-      {
-         _put(node.get(), node->m_left, key, value);
-      }
-      else if (m_less(node->m_key, key))
-      {
-         _put(node.get(), node->m_right, key, value);
-      }
-      else
-      {
-         node->m_value = value;
-      }
+      node_ptr_t node(arena.create(nullptr, (*it).first, (*it).second));
+      ++it;
+      return node;
+   }
+
+   // Takes over a node unlinked from a tree instead of creating one.
+   static node_ptr_t make_node(arena_t&, node_ptr_t*& it)
+   {
+      auto node = std::move(*it);
+      ++it;
+      node->set_parent(nullptr);
+      return node;
    }
 
    static void remove_node(node_ptr_t& node)
    {
+      auto parent = node->parent();
       if (!node->m_right)
       {
          auto tmp = std::move(node);
@@ -79,41 +156,63 @@ private:
       }
       else
       {
-         auto node_min = std::move(find_min(node->m_right));
+         auto node_min = detach_min(node->m_right);
          node_min->m_left = std::move(node->m_left);
          node_min->m_right = std::move(node->m_right);
+         node_min->m_left->set_parent(node_min.get());
+         if (node_min->m_right)
+            node_min->m_right->set_parent(node_min.get());
+         node_min->m_count = node->m_count - 1;
          node = std::move(node_min);
       }
+
+      if (node)
+         node->set_parent(parent);
    }
 
-   static node_ptr_t& find_min(node_ptr_t& node)
+   // Unlinks the smallest node of a non-empty subtree.
+   static node_ptr_t detach_min(node_ptr_t& node)
    {
-      if (!node || !node->m_left)
-         return node;
-      return find_min(node->m_left);
+      auto slot = &node;
+      while ((*slot)->m_left)
+      {
+         --(*slot)->m_count;
+         slot = &(*slot)->m_left;
+      }
+
+      auto n = std::move(*slot);
+      *slot = std::move(n->m_right);
+      if (*slot)
+         (*slot)->set_parent(n->parent());
+      return n;
    }
 };
 
 
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType, typename AllocType>
 struct bst_node_t: public node_base_t<KeyType, ValueType,
-                                      bst_node_t<KeyType, ValueType>>
+                                      bst_node_t<KeyType, ValueType, AllocType>>
 {
    using base_t = node_base_t<KeyType, ValueType,
-                              bst_node_t<KeyType, ValueType>>;
+                              bst_node_t<KeyType, ValueType, AllocType>>;
+   using alloc_t = AllocType;
 
-   bst_node_t(bst_node_t* parent, const KeyType& key, const ValueType& value):
-      base_t(parent, key, value)
+   template <typename KeyArgType, typename... ValueArgTypes>
+   bst_node_t(bst_node_t* parent, KeyArgType&& key, ValueArgTypes&&... args):
+      base_t(parent, std::forward<KeyArgType>(key),
+             std::forward<ValueArgTypes>(args)...)
    {}
 };
 
 }
 
 template<typename KeyType, typename ValueType,
-          typename LessType = std::less<KeyType>>
+          typename LessType = std::less<KeyType>,
+          typename AllocType = heap_alloc_t>
 using bs_tree_t = 
-   detail::tree_t<detail::bst_node_t<KeyType, ValueType>, LessType,
-                  detail::bst_impl_t<detail::bst_node_t<KeyType, ValueType>,
+   detail::tree_t<detail::bst_node_t<KeyType, ValueType, AllocType>, LessType,
+                  detail::bst_impl_t<detail::bst_node_t<KeyType, ValueType,
+                                                        AllocType>,
                                      LessType>>;
 
 }
@@ -0,0 +1,284 @@
+#ifndef DATASTRUCTURES_CORO_LOOKUP_HPP
+#define DATASTRUCTURES_CORO_LOOKUP_HPP
+
+// Tree lookups written as C++20 coroutines, so that many of them can be
+// interleaved. Nothing is defined unless the compiler supports coroutines,
+// in which case DS_HAS_COROUTINES is.
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define DS_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef DS_HAS_COROUTINES
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "ds/tree.hpp"
+
+namespace ds
+{
+
+// A lookup in progress. It starts suspended, is driven by a
+// lookup_scheduler_t and writes its result where it was told to.
+class lookup_task_t
+{
+public:
+   struct promise_type
+   {
+      lookup_task_t get_return_object()
+      {
+         return lookup_task_t(handle_t::from_promise(*this));
+      }
+
+      std::suspend_always initial_suspend() noexcept { return {}; }
+
+      std::suspend_always final_suspend() noexcept { return {}; }
+
+      void return_void() {}
+
+      // the lookup ends on an exception of the comparator, which is kept
+      // for the scheduler to rethrow
+      void unhandled_exception()
+      {
+         m_exception = std::current_exception();
+      }
+
+      std::exception_ptr m_exception;
+   };
+
+   lookup_task_t() = default;
+
+   lookup_task_t(lookup_task_t&& other):
+      m_handle(std::exchange(other.m_handle, nullptr))
+   {}
+
+   lookup_task_t& operator=(lookup_task_t&& other)
+   {
+      if (this != &other)
+      {
+         reset();
+         m_handle = std::exchange(other.m_handle, nullptr);
+      }
+      return *this;
+   }
+
+   ~lookup_task_t()
+   {
+      reset();
+   }
+
+   bool done() const
+   {
+      return m_handle.done();
+   }
+
+   void resume() const
+   {
+      m_handle.resume();
+   }
+
+   // The exception the lookup ended on, if any.
+   std::exception_ptr exception() const
+   {
+      return m_handle.promise().m_exception;
+   }
+
+private:
+   using handle_t = std::coroutine_handle<promise_type>;
+
+   handle_t m_handle;
+
+   explicit lookup_task_t(handle_t handle):
+      m_handle(handle)
+   {}
+
+   void reset()
+   {
+      if (m_handle)
+         m_handle.destroy();
+      m_handle = nullptr;
+   }
+};
+
+namespace detail
+{
+
+// Awaiting it prefetches a node and suspends the lookup, so that others run
+// while the node is on its way.
+struct prefetch_node_t
+{
+   const void* m_node;
+
+   bool await_ready() const noexcept { return false; }
+
+   void await_suspend(std::coroutine_handle<>) const noexcept
+   {
+#if defined(__GNUC__)
+      __builtin_prefetch(m_node);
+#endif
+   }
+
+   void await_resume() const noexcept {}
+};
+
+}
+
+// The lookups below mirror get, lower_bound and rank of tree_t, suspending
+// before every node but the root. The tree and out must outlive them; the
+// key is copied.
+
+template <typename TreeType, typename KeyArgType>
+lookup_task_t co_get(const TreeType& tree, KeyArgType key,
+                     typename TreeType::value_t*& out)
+{
+   const auto& less = tree.key_comp();
+   auto node = detail::tree_access_t::root(tree).get();
+   while (node)
+   {
+      if (less(key, node->m_key))
+         node = node->m_left.get();
+      else if (less(node->m_key, key))
+         node = node->m_right.get();
+      else
+         break;
+
+      if (node)
+         co_await detail::prefetch_node_t{node};
+   }
+   out = node ? &node->m_value : nullptr;
+}
+
+template <typename TreeType, typename KeyArgType>
+lookup_task_t co_lower_bound(const TreeType& tree, KeyArgType key,
+                             typename TreeType::const_iterator& out)
+{
+   const auto& less = tree.key_comp();
+   const auto& root = detail::tree_access_t::root(tree);
+   decltype(root.get()) candidate = nullptr;
+   auto node = root.get();
+   while (node)
+   {
+      if (less(node->m_key, key))
+      {
+         node = node->m_right.get();
+      }
+      else
+      {
+         candidate = node;
+         node = node->m_left.get();
+      }
+
+      if (node)
+         co_await detail::prefetch_node_t{node};
+   }
+   out = typename TreeType::const_iterator(candidate, &root);
+}
+
+template <typename TreeType, typename KeyArgType>
+lookup_task_t co_rank(const TreeType& tree, KeyArgType key, std::size_t& out)
+{
+   const auto& less = tree.key_comp();
+   auto node = detail::tree_access_t::root(tree).get();
+   std::size_t r = 0;
+   while (node)
+   {
+      if (less(key, node->m_key))
+      {
+         node = node->m_left.get();
+      }
+      else if (less(node->m_key, key))
+      {
+         r += 1 + detail::node_count(node->m_left);
+         node = node->m_right.get();
+      }
+      else
+      {
+         r += detail::node_count(node->m_left);
+         break;
+      }
+
+      if (node)
+         co_await detail::prefetch_node_t{node};
+   }
+   out = r;
+}
+
+// Runs up to width lookups at once, resuming them in turn: each one goes
+// down a level and prefetches its next node while the others do the same.
+// The exception a lookup ends on is rethrown by the spawn or run that
+// resumed it, once it is out of the scheduler; the other lookups stay in
+// flight.
+class lookup_scheduler_t
+{
+public:
+   explicit lookup_scheduler_t(std::size_t width = 32):
+      m_width(std::max<std::size_t>(width, 1))
+   {
+      m_tasks.reserve(m_width);
+   }
+
+   // Adds a lookup. When all the slots are taken, lookups in flight are
+   // resumed until one completes and hands its slot over.
+   void spawn(lookup_task_t task)
+   {
+      while (m_tasks.size() == m_width)
+      {
+         auto& t = m_tasks[m_next];
+         t.resume();
+         m_next = (m_next + 1) % m_width;
+         if (t.done())
+         {
+            const auto e = t.exception();
+            t = std::move(task);
+            if (e)
+               std::rethrow_exception(e);
+            return;
+         }
+      }
+      m_tasks.push_back(std::move(task));
+   }
+
+   // Runs the lookups in flight to completion.
+   void run()
+   {
+      while (!m_tasks.empty())
+      {
+         if (m_next >= m_tasks.size())
+            m_next = 0;
+
+         auto& t = m_tasks[m_next];
+         t.resume();
+         if (!t.done())
+         {
+            ++m_next;
+            continue;
+         }
+
+         const auto e = t.exception();
+         if (m_next + 1 != m_tasks.size())
+            t = std::move(m_tasks.back());
+         m_tasks.pop_back();
+         if (e)
+            std::rethrow_exception(e);
+      }
+      m_next = 0;
+   }
+
+private:
+   std::vector<lookup_task_t> m_tasks;
+   std::size_t m_width;
+   std::size_t m_next = 0;
+};
+
+}
+
+#endif
+
+#endif
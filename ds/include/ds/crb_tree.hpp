@@ -0,0 +1,345 @@
+#ifndef DATASTRUCTURES_CRB_TREE_HPP
+#define DATASTRUCTURES_CRB_TREE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include "ds/rb_tree.hpp"
+#include "ds/tree.hpp"
+
+namespace ds
+{
+
+namespace detail
+{
+
+// Classic (not left-leaning) red-black tree. Insertion and deletion descend
+// iteratively and fix the tree up through the parent links, with at most two
+// rotations per insertion and three per deletion.
+template<typename NodeType, typename LessType>
+struct crbt_impl_t
+{
+   using node_ptr_t = typename node_trait_t<NodeType>::ptr_t;
+   using key_t = typename node_trait_t<NodeType>::key_t;
+   using value_t = typename node_trait_t<NodeType>::value_t;
+   using arena_t =
+      typename NodeType::alloc_t::template arena_t<NodeType>;
+   using color_t = typename NodeType::color_t;
+
+   crbt_impl_t(const LessType& less):
+      m_less(less)
+   {}
+
+   // Creates a node out of key and args unless the key is already present.
+   // Returns the node holding the key and whether it was created.
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<NodeType*, bool> emplace(arena_t& arena, node_ptr_t& root,
+                                      KeyArgType&& key,
+                                      ArgTypes&&... args) const
+   {
+      assert(is_sound(root));
+      NodeType* parent = nullptr;
+      auto slot = &root;
+      while (*slot)
+      {
+         const auto node = slot->get();
+         if (m_less(key, node->m_key))
+         {
+            slot = &node->m_left;
+         }
+         else if (m_less(node->m_key, key))
+         {
+            slot = &node->m_right;
+         }
+         else
+         {
+            return std::make_pair(node, false);
+         }
+         parent = node;
+      }
+
+      return std::make_pair(emplace_at(arena, root, parent, *slot,
+                                       std::forward<KeyArgType>(key),
+                                       std::forward<ArgTypes>(args)...),
+                            true);
+   }
+
+   // Creates a node out of key and args in link, the empty link of parent
+   // where the key belongs, and returns it.
+   template <typename KeyArgType, typename... ArgTypes>
+   NodeType* emplace_at(arena_t& arena, node_ptr_t& root, NodeType* parent,
+                        node_ptr_t& link, KeyArgType&& key,
+                        ArgTypes&&... args) const
+   {
+      const auto z = arena.create(parent, color_t::red,
+                                  std::forward<KeyArgType>(key),
+                                  std::forward<ArgTypes>(args)...);
+      link = node_ptr_t(z);
+      for (auto p = parent; p; p = p->parent())
+         ++p->m_count;
+
+      insert_fixup(root, z);
+      assert(is_sound(root));
+      return z;
+   }
+
+   // Returns true when a node with the given key was found and removed.
+   template <typename KeyArgType>
+   bool remove(node_ptr_t& root, const KeyArgType& key) const
+   {
+      assert(is_sound(root));
+      auto z = root.get();
+      while (z)
+      {
+         if (m_less(key, z->m_key))
+            z = z->m_left.get();
+         else if (m_less(z->m_key, key))
+            z = z->m_right.get();
+         else
+            break;
+      }
+
+      if (!z)
+         return false;
+
+      auto& z_slot = slot(root, z);
+      auto removed_color = z->color();
+      NodeType* x = nullptr;
+      NodeType* x_parent = nullptr;
+
+      if (!z->m_left || !z->m_right)
+      {
+         x_parent = z->parent();
+         auto old = std::move(z_slot);
+         z_slot = std::move(old->m_left ? old->m_left : old->m_right);
+         if (z_slot)
+            z_slot->set_parent(x_parent);
+         x = z_slot.get();
+      }
+      else
+      {
+         // the successor y takes the place of z
+         auto y = tree_min(z->m_right.get());
+         removed_color = y->color();
+         x_parent = y->parent() == z ? y : y->parent();
+
+         auto& y_slot = slot(root, y);
+         auto y_owner = std::move(y_slot);
+         y_slot = std::move(y->m_right);
+         if (y_slot)
+            y_slot->set_parent(y->parent());
+         x = y_slot.get();
+
+         y->m_left = std::move(z->m_left);
+         y->m_left->set_parent(y);
+         y->m_right = std::move(z->m_right);
+         if (y->m_right)
+            y->m_right->set_parent(y);
+         y->set_parent(z->parent());
+         y->set_color(z->color());
+
+         auto old = std::move(z_slot);
+         z_slot = std::move(y_owner);
+      }
+
+      for (auto p = x_parent; p; p = p->parent())
+         update_count(p);
+
+      if (removed_color == color_t::black)
+         remove_fixup(root, x, x_parent);
+
+      assert(is_sound(root));
+      return true;
+   }
+
+   // Any left-leaning red-black tree is a valid red-black tree.
+   template <typename IteratorType>
+   static node_ptr_t build(arena_t& arena, IteratorType& it, std::size_t n)
+   {
+      return rbt_impl_t<NodeType, LessType>::build(arena, it, n);
+   }
+
+private:
+   LessType m_less;
+
+   static bool is_red(const NodeType* node)
+   {
+      return node && node->color() == color_t::red;
+   }
+
+   static node_ptr_t& slot(node_ptr_t& root, NodeType* node)
+   {
+      const auto p = node->parent();
+      if (!p)
+         return root;
+      return node == p->m_left.get() ? p->m_left : p->m_right;
+   }
+
+   static void rotate(node_ptr_t& root, NodeType* h,
+                      node_ptr_t NodeType::* src, node_ptr_t NodeType::* dst)
+   {
+#ifdef DS_TREE_STATS
+      tree_stats_t::rotations().fetch_add(1, std::memory_order_relaxed);
+#endif
+      auto& h_slot = slot(root, h);
+      node_ptr_t x = std::move(h->*src);
+      h->*src = std::move(x.get()->*dst);
+      if (h->*src)
+         (h->*src)->set_parent(h);
+      x->set_parent(h->parent());
+      x->m_count = h->m_count;
+      x.get()->*dst = std::move(h_slot);
+      h->set_parent(x.get());
+      update_count(h);
+      h_slot = std::move(x);
+   }
+
+   static void rotate_left(node_ptr_t& root, NodeType* h)
+   {
+      rotate(root, h, &NodeType::m_right, &NodeType::m_left);
+   }
+
+   static void rotate_right(node_ptr_t& root, NodeType* h)
+   {
+      rotate(root, h, &NodeType::m_left, &NodeType::m_right);
+   }
+
+   static void insert_fixup(node_ptr_t& root, NodeType* z)
+   {
+      while (is_red(z->parent()))
+      {
+         auto p = z->parent();
+         auto g = p->parent();
+         const bool left = p == g->m_left.get();
+         const auto u = left ? g->m_right.get() : g->m_left.get();
+
+         if (is_red(u))
+         {
+            p->set_color(color_t::black);
+            u->set_color(color_t::black);
+            g->set_color(color_t::red);
+            z = g;
+            continue;
+         }
+
+         if (z == (left ? p->m_right.get() : p->m_left.get()))
+         {
+            z = p;
+            left ? rotate_left(root, z) : rotate_right(root, z);
+            p = z->parent();
+         }
+
+         p->set_color(color_t::black);
+         g->set_color(color_t::red);
+         left ? rotate_right(root, g) : rotate_left(root, g);
+      }
+
+      root->set_color(color_t::black);
+   }
+
+   static void remove_fixup(node_ptr_t& root, NodeType* x, NodeType* x_parent)
+   {
+      while (x != root.get() && !is_red(x))
+      {
+         const bool left = x == x_parent->m_left.get();
+         auto w = left ? x_parent->m_right.get() : x_parent->m_left.get();
+
+         if (is_red(w))
+         {
+            w->set_color(color_t::black);
+            x_parent->set_color(color_t::red);
+            left ? rotate_left(root, x_parent) : rotate_right(root, x_parent);
+            w = left ? x_parent->m_right.get() : x_parent->m_left.get();
+         }
+
+         auto near = left ? w->m_left.get() : w->m_right.get();
+         auto far = left ? w->m_right.get() : w->m_left.get();
+         if (!is_red(near) && !is_red(far))
+         {
+            w->set_color(color_t::red);
+            x = x_parent;
+            x_parent = x->parent();
+            continue;
+         }
+
+         if (!is_red(far))
+         {
+            near->set_color(color_t::black);
+            w->set_color(color_t::red);
+            left ? rotate_right(root, w) : rotate_left(root, w);
+            w = left ? x_parent->m_right.get() : x_parent->m_left.get();
+            far = left ? w->m_right.get() : w->m_left.get();
+         }
+
+         w->set_color(x_parent->color());
+         x_parent->set_color(color_t::black);
+         far->set_color(color_t::black);
+         left ? rotate_left(root, x_parent) : rotate_right(root, x_parent);
+         x = root.get();
+      }
+
+      if (x)
+         x->set_color(color_t::black);
+   }
+
+   static bool is_sound(const node_ptr_t& root)
+   {
+      std::size_t nb_black_links = 0;
+      return !is_red(root.get()) && (!root || !root->parent()) &&
+         is_node_sound(root.get(), nb_black_links);
+   }
+
+   static bool is_node_sound(const NodeType* h, std::size_t& nb_black_links)
+   {
+      nb_black_links = 0;
+      if (!h)
+         return true;
+
+      if (is_red(h) && (is_red(h->m_left.get()) || is_red(h->m_right.get())))
+         return false;
+      if (h->m_left && h->m_left->parent() != h)
+         return false;
+      if (h->m_right && h->m_right->parent() != h)
+         return false;
+      if (h->m_count != 1 + node_count(h->m_left) + node_count(h->m_right))
+         return false;
+
+      std::size_t nb_left = 0, nb_right = 0;
+      if (!is_node_sound(h->m_left.get(), nb_left) ||
+          !is_node_sound(h->m_right.get(), nb_right) ||
+          nb_left != nb_right)
+         return false;
+
+      nb_black_links = nb_left + (is_red(h) ? 0 : 1);
+      return true;
+   }
+};
+
+}
+
+template<typename KeyType, typename ValueType,
+         typename LessType = std::less<KeyType>,
+         typename AllocType = heap_alloc_t>
+   using crb_tree_t =
+   detail::tree_t<detail::rbt_node_t<KeyType, ValueType, AllocType>, LessType,
+                  detail::crbt_impl_t<detail::rbt_node_t<KeyType, ValueType,
+                                                         AllocType>,
+                                      LessType>>;
+
+// crb_tree_t over rbt_compact_node_t.
+template<typename KeyType, typename ValueType,
+         typename LessType = std::less<KeyType>,
+         typename AllocType = heap_alloc_t>
+   using compact_crb_tree_t =
+   detail::tree_t<detail::rbt_compact_node_t<KeyType, ValueType, AllocType>,
+                  LessType,
+                  detail::crbt_impl_t<detail::rbt_compact_node_t<KeyType,
+                                                                 ValueType,
+                                                                 AllocType>,
+                                      LessType>>;
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef DATASTRUCTURES_EPOCH_HPP
+#define DATASTRUCTURES_EPOCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace ds
+{
+
+namespace detail
+{
+
+// Epoch-based reclamation shared by the concurrent containers of the process.
+// Readers publish the epoch they entered in; memory retired in epoch e is
+// freed once no reader is left in e or an older epoch.
+class epoch_domain_t
+{
+   struct alignas(64) slot_t
+   {
+      // 0 while the thread is not reading
+      std::atomic<std::uint64_t> m_epoch;
+      std::atomic<bool> m_used;
+   };
+
+public:
+   static constexpr std::size_t max_readers = 256;
+
+   static epoch_domain_t& instance()
+   {
+      static epoch_domain_t domain;
+      return domain;
+   }
+
+   // Read-side critical section of the calling thread. Sections nest.
+   class guard_t
+   {
+   public:
+      guard_t():
+         m_thread(thread_slot())
+      {
+         if (m_thread.m_depth++ == 0)
+            m_thread.m_slot->m_epoch.store(instance().m_epoch.load());
+      }
+
+      ~guard_t()
+      {
+         if (--m_thread.m_depth == 0)
+            m_thread.m_slot->m_epoch.store(0, std::memory_order_release);
+      }
+
+      guard_t(const guard_t&) = delete;
+      guard_t& operator=(const guard_t&) = delete;
+
+   private:
+      struct thread_slot_t
+      {
+         thread_slot_t():
+            m_slot(instance().claim())
+         {}
+
+         ~thread_slot_t()
+         {
+            m_slot->m_used.store(false, std::memory_order_release);
+         }
+
+         slot_t* m_slot;
+         std::size_t m_depth = 0;
+      };
+
+      thread_slot_t& m_thread;
+
+      static thread_slot_t& thread_slot()
+      {
+         static thread_local thread_slot_t slot;
+         return slot;
+      }
+   };
+
+   // Moves to the next epoch, returning the one that ended.
+   std::uint64_t advance()
+   {
+      return m_epoch.fetch_add(1);
+   }
+
+   // Oldest epoch a reader may still be in, the current one if none is.
+   std::uint64_t oldest() const
+   {
+      auto oldest = m_epoch.load();
+      const auto n = m_nb_slots.load();
+      for (std::size_t i = 0; i < n; ++i)
+      {
+         const auto e = m_slots[i].m_epoch.load();
+         if (e != 0 && e < oldest)
+            oldest = e;
+      }
+      return oldest;
+   }
+
+private:
+   slot_t m_slots[max_readers] = {};
+   std::atomic<std::size_t> m_nb_slots{0};
+   std::atomic<std::uint64_t> m_epoch{1};
+
+   slot_t* claim()
+   {
+      for (std::size_t i = 0; i < max_readers; ++i)
+      {
+         bool used = false;
+         if (m_slots[i].m_used.compare_exchange_strong(used, true))
+         {
+            auto n = m_nb_slots.load();
+            while (n <= i && !m_nb_slots.compare_exchange_weak(n, i + 1))
+            {}
+            return &m_slots[i];
+         }
+      }
+      throw std::length_error("ds::epoch_domain_t: too many threads");
+   }
+};
+
+// Memory unlinked from a concurrent container and waiting for the readers
+// that may still see it. Retired objects derive from it and say how to
+// free themselves.
+struct retired_t
+{
+   explicit retired_t(void (*free)(retired_t*)):
+      m_free(free)
+   {}
+
+   retired_t* m_next_retired = nullptr;
+   std::uint64_t m_epoch = 0;
+   void (*m_free)(retired_t*);
+};
+
+// Lock-free list of retired memory, for containers retired to by many
+// threads at once.
+class limbo_t
+{
+public:
+   limbo_t() = default;
+
+   // Nobody may be retiring anymore.
+   ~limbo_t()
+   {
+      free_all(m_head.load());
+   }
+
+   limbo_t(const limbo_t&) = delete;
+   limbo_t& operator=(const limbo_t&) = delete;
+
+   // Retires r, which must be unreachable to readers entering from now on,
+   // and now and then frees what no reader can see anymore.
+   void retire(retired_t* r)
+   {
+      auto& domain = epoch_domain_t::instance();
+      r->m_epoch = domain.advance();
+      push(r, r);
+      if (m_nb_pending.fetch_add(1, std::memory_order_relaxed) + 1 >=
+          m_threshold.load(std::memory_order_relaxed))
+         reclaim(domain.oldest());
+   }
+
+private:
+   static constexpr std::size_t min_period = 64;
+
+   std::atomic<retired_t*> m_head{nullptr};
+   std::atomic<std::size_t> m_nb_pending{0};
+   std::atomic<std::size_t> m_threshold{min_period};
+
+   // Pushes the chain from first to last.
+   void push(retired_t* first, retired_t* last)
+   {
+      last->m_next_retired = m_head.load();
+      while (!m_head.compare_exchange_weak(last->m_next_retired, first))
+      {}
+   }
+
+   // Takes the whole list, so that concurrent reclaims never meet. What a
+   // slow reader still holds back is only looked at again after as many
+   // retirements, which keeps reclaiming linear.
+   void reclaim(std::uint64_t oldest)
+   {
+      m_nb_pending.store(0, std::memory_order_relaxed);
+      auto r = m_head.exchange(nullptr);
+      retired_t* kept = nullptr;
+      retired_t* last = nullptr;
+      std::size_t nb_kept = 0;
+      while (r)
+      {
+         const auto next = r->m_next_retired;
+         if (r->m_epoch < oldest)
+         {
+            r->m_free(r);
+         }
+         else
+         {
+            r->m_next_retired = kept;
+            kept = r;
+            if (!last)
+               last = r;
+            ++nb_kept;
+         }
+         r = next;
+      }
+      if (kept)
+         push(kept, last);
+      if (nb_kept < min_period)
+         nb_kept = min_period;
+      m_threshold.store(nb_kept, std::memory_order_relaxed);
+   }
+
+   static void free_all(retired_t* r)
+   {
+      while (r)
+      {
+         const auto next = r->m_next_retired;
+         r->m_free(r);
+         r = next;
+      }
+   }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,400 @@
+#ifndef DATASTRUCTURES_FROZEN_TREE_HPP
+#define DATASTRUCTURES_FROZEN_TREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "ds/tree.hpp"
+
+namespace ds
+{
+
+// Keys of a complete binary search tree stored in breadth-first order: the
+// children of position i are 2i and 2i + 1 (positions are 1-based). A
+// lookup only ever moves forward in the array, the top levels share a few
+// cache lines and the descendants four levels down a node are contiguous,
+// so they can be prefetched while comparing.
+struct eytzinger_layout_t
+{
+   // Position of each rank in [0, n).
+   static std::vector<std::size_t> positions(std::size_t n)
+   {
+      std::vector<std::size_t> pos(n);
+      std::size_t i = 1;
+      while (2 * i <= n)
+         i = 2 * i;
+      for (std::size_t r = 0; r < n; ++r)
+      {
+         pos[r] = i;
+         i = next(i, n);
+      }
+      return pos;
+   }
+
+   // Position of the first key not less than key, 0 if there is none. keys
+   // holds the key of position i at index i - 1.
+   template <typename KeyType, typename LessType>
+   static std::size_t lower_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType& less)
+   {
+      constexpr std::size_t stride =
+         64 / sizeof(KeyType) == 0 ? 1 : 64 / sizeof(KeyType);
+
+      std::size_t i = 1;
+      while (i <= n)
+      {
+#if defined(__GNUC__)
+         __builtin_prefetch(keys + (stride * i - 1));
+#endif
+         i = 2 * i + less(keys[i - 1], key);
+      }
+
+      // the answer is where the search last went left: drop the trailing
+      // right turns and the final left one
+      while (i & 1)
+         i >>= 1;
+      return i >> 1;
+   }
+
+private:
+   // In-order successor of position i, 0 past the last one.
+   static std::size_t next(std::size_t i, std::size_t n)
+   {
+      if (2 * i + 1 <= n)
+      {
+         i = 2 * i + 1;
+         while (2 * i <= n)
+            i = 2 * i;
+         return i;
+      }
+
+      while (i & 1)
+         i >>= 1;
+      return i >> 1;
+   }
+};
+
+// Keys of the same complete tree as eytzinger_layout_t, stored in van Emde
+// Boas order: the tree is cut at half its height, then the top tree and each
+// of the bottom trees, left to right, are stored recursively one after the
+// other. Whatever the block size, cache line or page, a lookup crosses
+// O(log_B n) blocks, which also holds for an index read cold from disk.
+//
+// Positions are computed while descending, from a per-depth table that
+// tells which cut a depth lies under (Brodal, Fagerberg and Jacob). The last
+// level of the tree may be partial; the bottom trees it belongs to are
+// shrunk accordingly so that the n keys are stored without holes.
+struct veb_layout_t
+{
+   static std::vector<std::size_t> positions(std::size_t n)
+   {
+      // Eytzinger positions are the breadth-first indices of the nodes
+      auto pos = eytzinger_layout_t::positions(n);
+      const auto h = detail::bit_width(n);
+      const auto c = cuts(h);
+      std::size_t path[max_height];
+      path[0] = 1;
+      for (auto& p : pos)
+      {
+         const auto d = detail::bit_width(p) - 1;
+         for (unsigned k = 1; k <= d; ++k)
+            path[k] = position(c, path, p >> (d - k), k, n, h);
+         p = path[d];
+      }
+      return pos;
+   }
+
+   // Position of the first key not less than key, 0 if there is none. keys
+   // holds the key of position i at index i - 1.
+   template <typename KeyType, typename LessType>
+   static std::size_t lower_bound(const KeyType* keys, std::size_t n,
+                                  const KeyType& key, const LessType& less)
+   {
+      const auto h = detail::bit_width(n);
+      const auto c = cuts(h);
+      std::size_t path[max_height];
+      path[0] = 1;
+
+      std::size_t found = 0;
+      std::size_t i = 1;
+      for (unsigned d = 0; i <= n; ++d)
+      {
+         if (d > 0)
+            path[d] = position(c, path, i, d, n, h);
+         const auto p = path[d];
+         const bool right = less(keys[p - 1], key);
+         found = right ? found : p;
+         i = 2 * i + right;
+      }
+      return found;
+   }
+
+private:
+   static constexpr unsigned max_height =
+      std::numeric_limits<std::size_t>::digits;
+
+   // The cut a depth is the first bottom level of.
+   struct cut_t
+   {
+      unsigned top_depth;
+      unsigned bottom_height;
+      std::size_t top_size;
+   };
+
+   struct cuts_t
+   {
+      cut_t by_height[max_height + 1][max_height];
+
+      cuts_t()
+      {
+         for (unsigned h = 0; h <= max_height; ++h)
+            split(by_height[h], 0, h);
+      }
+
+      static void split(cut_t* cuts, unsigned top_depth, unsigned height)
+      {
+         if (height < 2)
+            return;
+         const auto top = height / 2;
+         const auto bottom = height - top;
+         cuts[top_depth + top] =
+            cut_t{top_depth, bottom, (std::size_t(1) << top) - 1};
+         split(cuts, top_depth, top);
+         split(cuts, top_depth + top, bottom);
+      }
+   };
+
+   // Cuts of a tree of height h, by depth.
+   static const cut_t* cuts(unsigned h)
+   {
+      static const cuts_t all;
+      return all.by_height[h];
+   }
+
+   // Position of breadth-first index i at depth d > 0, path holding the
+   // positions of its ancestors, in a tree of n keys and height h.
+   static std::size_t position(const cut_t* cuts, const std::size_t* path,
+                               std::size_t i, unsigned d, std::size_t n,
+                               unsigned h)
+   {
+      const auto& c = cuts[d];
+
+      // index of the bottom tree among the ones under the same top tree
+      const auto cut = d - c.top_depth;
+      const auto j = i & ((std::size_t(1) << cut) - 1);
+      const auto full = (std::size_t(1) << c.bottom_height) - 1;
+      auto offset = j * full;
+
+      if (d + c.bottom_height == h)
+      {
+         // the left-packed last level fills the first q bottom trees, r
+         // leaves of the next one, and none of the others
+         const auto half = std::size_t(1) << (c.bottom_height - 1);
+         const auto first = (i >> cut) << (h - 1 - c.top_depth);
+         const auto leaves =
+            n + 1 > first ? std::min(n + 1 - first, half << cut) : 0;
+         const auto q = leaves / half;
+         const auto r = leaves % half;
+         offset = j * (full - half) + std::min(j, q) * half + (j > q ? r : 0);
+      }
+      return path[c.top_depth] + c.top_size + offset;
+   }
+};
+
+template <typename KeyType, typename ValueType, typename LessType,
+          typename LayoutType>
+class frozen_tree_t;
+
+namespace detail
+{
+
+// Iterator over a frozen tree in key order.
+template <typename FrozenType>
+class frozen_iterator_t
+{
+   using key_t = typename FrozenType::key_t;
+   using mapped_t = typename FrozenType::value_t;
+
+public:
+   using iterator_category = std::bidirectional_iterator_tag;
+   using value_type = std::pair<const key_t, mapped_t>;
+   using difference_type = std::ptrdiff_t;
+   using reference = std::pair<const key_t&, const mapped_t&>;
+   using pointer = arrow_proxy_t<reference>;
+
+   frozen_iterator_t() = default;
+
+   frozen_iterator_t(const FrozenType* tree, std::size_t rank):
+      m_tree(tree),
+      m_rank(rank)
+   {}
+
+   reference operator*() const
+   {
+      const auto p = m_tree->m_positions[m_rank] - 1;
+      return reference(m_tree->m_keys[p], m_tree->m_values[p]);
+   }
+
+   pointer operator->() const
+   {
+      return pointer{**this};
+   }
+
+   frozen_iterator_t& operator++()
+   {
+      ++m_rank;
+      return *this;
+   }
+
+   frozen_iterator_t operator++(int)
+   {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+   }
+
+   frozen_iterator_t& operator--()
+   {
+      --m_rank;
+      return *this;
+   }
+
+   frozen_iterator_t operator--(int)
+   {
+      auto tmp = *this;
+      --*this;
+      return tmp;
+   }
+
+   friend bool operator==(const frozen_iterator_t& lhs,
+                          const frozen_iterator_t& rhs)
+   {
+      return lhs.m_rank == rhs.m_rank;
+   }
+
+   friend bool operator!=(const frozen_iterator_t& lhs,
+                          const frozen_iterator_t& rhs)
+   {
+      return lhs.m_rank != rhs.m_rank;
+   }
+
+private:
+   const FrozenType* m_tree = nullptr;
+   std::size_t m_rank = 0;
+};
+
+}
+
+// Immutable sorted map laid out in one contiguous array for lookups, see
+// freeze(). Keys and values are stored in LayoutType order; the rank of
+// every position and the position of every rank are kept next to them.
+template <typename KeyType, typename ValueType,
+          typename LessType = std::less<KeyType>,
+          typename LayoutType = eytzinger_layout_t>
+class frozen_tree_t
+{
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using const_iterator = detail::frozen_iterator_t<frozen_tree_t>;
+   using iterator = const_iterator;
+
+   frozen_tree_t(const LessType& less = LessType()):
+      m_less(less)
+   {}
+
+   // Builds the index out of a range of (key, value) pairs sorted by
+   // strictly increasing keys.
+   template <typename IteratorType>
+   frozen_tree_t(IteratorType begin, IteratorType end,
+                 const LessType& less = LessType()):
+      m_less(less)
+   {
+      std::vector<std::pair<const key_t*, const value_t*>> sorted;
+      for (auto it = begin; it != end; ++it)
+      {
+         auto&& kv = *it;
+         sorted.emplace_back(&kv.first, &kv.second);
+      }
+
+      const auto n = sorted.size();
+      m_positions = LayoutType::positions(n);
+      m_ranks.resize(n);
+      for (std::size_t r = 0; r < n; ++r)
+         m_ranks[m_positions[r] - 1] = r;
+
+      m_keys.reserve(n);
+      m_values.reserve(n);
+      for (auto r : m_ranks)
+      {
+         m_keys.push_back(*sorted[r].first);
+         m_values.push_back(*sorted[r].second);
+      }
+   }
+
+   const value_t* get(const key_t& key) const
+   {
+      const auto p = find(key);
+      if (p == 0 || m_less(key, m_keys[p - 1]))
+         return nullptr;
+      return &m_values[p - 1];
+   }
+
+   // Number of keys strictly less than key.
+   std::size_t rank(const key_t& key) const
+   {
+      const auto p = find(key);
+      return p == 0 ? size() : m_ranks[p - 1];
+   }
+
+   // First element whose key is not less than key.
+   const_iterator lower_bound(const key_t& key) const
+   {
+      return const_iterator(this, rank(key));
+   }
+
+   std::size_t size() const
+   {
+      return m_keys.size();
+   }
+
+   const_iterator begin() const { return const_iterator(this, 0); }
+
+   const_iterator end() const { return const_iterator(this, size()); }
+
+private:
+   friend const_iterator;
+
+   std::vector<key_t> m_keys;
+   std::vector<value_t> m_values;
+   std::vector<std::size_t> m_ranks;
+   std::vector<std::size_t> m_positions;
+   LessType m_less;
+
+   std::size_t find(const key_t& key) const
+   {
+      return LayoutType::lower_bound(m_keys.data(), m_keys.size(), key,
+                                     m_less);
+   }
+};
+
+// Snapshot of a tree (or any map iterating in key order) as a frozen_tree_t.
+// The tree is left untouched.
+template <typename LayoutType = eytzinger_layout_t, typename TreeType>
+frozen_tree_t<typename TreeType::key_t, typename TreeType::value_t,
+              typename TreeType::less_t, LayoutType>
+freeze(const TreeType& tree)
+{
+   return frozen_tree_t<typename TreeType::key_t, typename TreeType::value_t,
+                        typename TreeType::less_t, LayoutType>(
+      tree.begin(), tree.end(), tree.key_comp());
+}
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef DATASTRUCTURES_NODE_ALLOC_HPP
+#define DATASTRUCTURES_NODE_ALLOC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace ds
+{
+
+namespace detail
+{
+
+constexpr std::size_t round_up(std::size_t n, std::size_t align)
+{
+   return (n + align - 1) / align * align;
+}
+
+constexpr std::size_t next_pow2(std::size_t n, std::size_t p = 1)
+{
+   return p >= n ? p : next_pow2(n, 2 * p);
+}
+
+// Number of bits needed to hold n.
+constexpr unsigned bit_width(std::size_t n)
+{
+   return n == 0 ? 0 : 1 + bit_width(n >> 1);
+}
+
+inline void* aligned_malloc(std::size_t size, std::size_t align)
+{
+#ifdef _WIN32
+   void* p = _aligned_malloc(size, align);
+#else
+   void* p = nullptr;
+   if (posix_memalign(&p, align, size) != 0)
+      p = nullptr;
+#endif
+   if (!p)
+      throw std::bad_alloc();
+   return p;
+}
+
+inline void aligned_free(void* p)
+{
+#ifdef _WIN32
+   _aligned_free(p);
+#else
+   std::free(p);
+#endif
+}
+
+// Fixed size-class allocator: nodes are carved out of slabs aligned on their
+// own size, so the owning pool of any node can be found from its address and
+// node deleters stay stateless (no extra word per child pointer).
+template <std::size_t Size, std::size_t Align>
+class node_pool_t
+{
+public:
+   node_pool_t() = default;
+   node_pool_t(const node_pool_t&) = delete;
+   node_pool_t& operator=(const node_pool_t&) = delete;
+
+   ~node_pool_t()
+   {
+      while (m_slabs)
+      {
+         auto next = m_slabs->m_next;
+         aligned_free(m_slabs);
+         m_slabs = next;
+      }
+   }
+
+   void* allocate()
+   {
+      if (m_free)
+      {
+         auto p = m_free;
+         m_free = m_free->m_next;
+         return p;
+      }
+
+      if (m_bump == m_bump_end)
+         add_slab();
+
+      auto p = m_bump;
+      m_bump += slot_size;
+      return p;
+   }
+
+   void deallocate(void* p)
+   {
+      auto slot = static_cast<free_slot_t*>(p);
+      slot->m_next = m_free;
+      m_free = slot;
+   }
+
+   static void release(void* p)
+   {
+      const auto addr = reinterpret_cast<std::uintptr_t>(p);
+      auto slab = reinterpret_cast<slab_t*>(addr & ~(slab_size - 1));
+      slab->m_pool->deallocate(p);
+   }
+
+private:
+   struct free_slot_t
+   {
+      free_slot_t* m_next;
+   };
+
+   struct slab_t
+   {
+      node_pool_t* m_pool;
+      slab_t* m_next;
+   };
+
+   static constexpr std::size_t align =
+      Align < alignof(free_slot_t) ? alignof(free_slot_t) : Align;
+   static constexpr std::size_t slot_size =
+      round_up(Size < sizeof(free_slot_t) ? sizeof(free_slot_t) : Size, align);
+   static constexpr std::size_t header_size = round_up(sizeof(slab_t), align);
+   static constexpr std::size_t slab_size =
+      next_pow2(header_size + 64 * slot_size) < 65536 ?
+      65536 : next_pow2(header_size + 64 * slot_size);
+
+   slab_t* m_slabs = nullptr;
+   free_slot_t* m_free = nullptr;
+   char* m_bump = nullptr;
+   char* m_bump_end = nullptr;
+
+   void add_slab()
+   {
+      auto slab = static_cast<slab_t*>(aligned_malloc(slab_size, slab_size));
+      slab->m_pool = this;
+      slab->m_next = m_slabs;
+      m_slabs = slab;
+
+      auto base = reinterpret_cast<char*>(slab);
+      m_bump = base + header_size;
+      m_bump_end = m_bump + (slab_size - header_size) / slot_size * slot_size;
+   }
+};
+
+}
+
+// Allocation policy giving every node its own heap allocation.
+struct heap_alloc_t
+{
+   // whether nodes may move from one tree to another
+   static constexpr bool movable_nodes = true;
+
+   template <typename NodeType>
+   struct arena_t
+   {
+      template <typename... Args>
+      NodeType* create(Args&&... args)
+      {
+         return new NodeType(std::forward<Args>(args)...);
+      }
+
+      static void destroy(NodeType* node)
+      {
+         delete node;
+      }
+   };
+};
+
+// Allocation policy drawing nodes from a slab pool owned by the tree. Removed
+// nodes go back to the pool free list and are reused by later insertions.
+struct pool_alloc_t
+{
+   // nodes go back to the pool of the tree that created them
+   static constexpr bool movable_nodes = false;
+
+   template <typename NodeType>
+   class arena_t
+   {
+   public:
+      template <typename... Args>
+      NodeType* create(Args&&... args)
+      {
+         if (!m_pool)
+            m_pool.reset(new pool_t());
+
+         auto p = m_pool->allocate();
+         try
+         {
+            return new (p) NodeType(std::forward<Args>(args)...);
+         }
+         catch (...)
+         {
+            m_pool->deallocate(p);
+            throw;
+         }
+      }
+
+      static void destroy(NodeType* node)
+      {
+         node->~NodeType();
+         pool_t::release(node);
+      }
+
+   private:
+      using pool_t = detail::node_pool_t<sizeof(NodeType), alignof(NodeType)>;
+
+      std::unique_ptr<pool_t> m_pool;
+   };
+};
+
+}
+
+#endif
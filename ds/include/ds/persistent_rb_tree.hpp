@@ -0,0 +1,534 @@
+#ifndef DATASTRUCTURES_PERSISTENT_RB_TREE_HPP
+#define DATASTRUCTURES_PERSISTENT_RB_TREE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ds/rb_tree.hpp"
+
+namespace ds
+{
+
+namespace detail
+{
+
+template <typename KeyType, typename ValueType>
+struct prbt_node_t
+{
+   using ptr_t = std::shared_ptr<prbt_node_t>;
+
+   prbt_node_t(const KeyType& key, const ValueType& value):
+      m_key(key),
+      m_value(value)
+   {}
+
+   ptr_t m_left;
+   ptr_t m_right;
+   KeyType m_key;
+   ValueType m_value;
+   std::size_t m_count = 1;
+   rb_color_t m_color = rb_color_t::red;
+};
+
+// Forward in-order iterator. Nodes have no parent link, as they are shared
+// between versions, so the path from the root is kept on a stack.
+template <typename NodeType>
+class prbt_iterator_t
+{
+   using key_t = decltype(NodeType::m_key);
+   using mapped_t = decltype(NodeType::m_value);
+
+public:
+   using iterator_category = std::forward_iterator_tag;
+   using value_type = std::pair<const key_t, mapped_t>;
+   using difference_type = std::ptrdiff_t;
+   using reference = std::pair<const key_t&, const mapped_t&>;
+   using pointer = arrow_proxy_t<reference>;
+
+   prbt_iterator_t() = default;
+
+   explicit prbt_iterator_t(const NodeType* root)
+   {
+      push_left(root);
+   }
+
+   reference operator*() const
+   {
+      const auto node = m_path.back();
+      return reference(node->m_key, node->m_value);
+   }
+
+   pointer operator->() const
+   {
+      return pointer{**this};
+   }
+
+   prbt_iterator_t& operator++()
+   {
+      const auto node = m_path.back();
+      m_path.pop_back();
+      push_left(node->m_right.get());
+      return *this;
+   }
+
+   prbt_iterator_t operator++(int)
+   {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+   }
+
+   friend bool operator==(const prbt_iterator_t& lhs,
+                          const prbt_iterator_t& rhs)
+   {
+      return lhs.node() == rhs.node();
+   }
+
+   friend bool operator!=(const prbt_iterator_t& lhs,
+                          const prbt_iterator_t& rhs)
+   {
+      return lhs.node() != rhs.node();
+   }
+
+private:
+   std::vector<const NodeType*> m_path;
+
+   const NodeType* node() const
+   {
+      return m_path.empty() ? nullptr : m_path.back();
+   }
+
+   void push_left(const NodeType* node)
+   {
+      for (; node; node = node->m_left.get())
+         m_path.push_back(node);
+   }
+};
+
+// Left-leaning red-black put and remove that never modify a node reachable
+// from a published version: every node they change is first made private
+// to the version being built by OwnerType, which provides
+//   node_ptr_t            the link between nodes,
+//   make(key, value)      a new node,
+//   own(node)             a private copy of node, unless it already is,
+//   drop(node)            unlinks a private node removed from the tree.
+template <typename OwnerType, typename LessType>
+class path_copy_rbt_t
+{
+public:
+   using node_ptr_t = typename OwnerType::node_ptr_t;
+   using node_t = typename std::pointer_traits<node_ptr_t>::element_type;
+   using key_t = decltype(node_t::m_key);
+   using value_t = decltype(node_t::m_value);
+
+   path_copy_rbt_t(OwnerType& owner, const LessType& less):
+      m_owner(owner),
+      m_less(less)
+   {}
+
+   void put(node_ptr_t& root, const key_t& key, const value_t& value)
+   {
+      _put(root, key, value);
+      root->m_color = rb_color_t::black;
+      assert(is_sound(root));
+   }
+
+   // The key must be present.
+   void remove(node_ptr_t& root, const key_t& key)
+   {
+      own(root);
+      if (!is_red(root->m_left) && !is_red(root->m_right))
+         root->m_color = rb_color_t::red;
+
+      _remove(root, key);
+
+      if (root)
+      {
+         own(root);
+         root->m_color = rb_color_t::black;
+      }
+      assert(is_sound(root));
+   }
+
+private:
+   OwnerType& m_owner;
+   const LessType& m_less;
+
+   void own(node_ptr_t& node)
+   {
+      m_owner.own(node);
+   }
+
+   void _put(node_ptr_t& h, const key_t& key, const value_t& value)
+   {
+      if (!h)
+      {
+         h = m_owner.make(key, value);
+         return;
+      }
+
+      own(h);
+      if (m_less(key, h->m_key))
+         _put(h->m_left, key, value);
+      else if (m_less(h->m_key, key))
+         _put(h->m_right, key, value);
+      else
+         h->m_value = value;
+
+      if (is_red(h->m_right) && !is_red(h->m_left))
+         rotate_left(h);
+      if (is_red(h->m_left) && is_red(h->m_left->m_left))
+         rotate_right(h);
+      if (is_red(h->m_left) && is_red(h->m_right))
+         flip_colors(h);
+      update_count(h);
+   }
+
+   void _remove(node_ptr_t& h, const key_t& key)
+   {
+      own(h);
+      if (m_less(key, h->m_key))
+      {
+         assert(h->m_left);
+         if (!is_red(h->m_left) && !is_red(h->m_left->m_left))
+            move_red_left(h);
+
+         _remove(h->m_left, key);
+      }
+      else
+      {
+         if (is_red(h->m_left))
+            rotate_right(h);
+
+         if (key_equal(key, h->m_key) && !h->m_right)
+         {
+            m_owner.drop(h);
+            return;
+         }
+
+         assert(h->m_right);
+         if (!is_red(h->m_right) && !is_red(h->m_right->m_left))
+            move_red_right(h);
+
+         if (key_equal(key, h->m_key))
+         {
+            // the minimum may be shared with other versions: copy it
+            auto node_min = &h->m_right;
+            while ((*node_min)->m_left)
+               node_min = &(*node_min)->m_left;
+            h->m_key = (*node_min)->m_key;
+            h->m_value = (*node_min)->m_value;
+            remove_min(h->m_right);
+         }
+         else
+         {
+            _remove(h->m_right, key);
+         }
+      }
+
+      balance(h);
+   }
+
+   bool key_equal(const key_t& lhs, const key_t& rhs) const
+   {
+      return !m_less(lhs, rhs) && !m_less(rhs, lhs);
+   }
+
+   void remove_min(node_ptr_t& h)
+   {
+      own(h);
+      if (!h->m_left)
+      {
+         m_owner.drop(h);
+         return;
+      }
+
+      if (!is_red(h->m_left) && !is_red(h->m_left->m_left))
+         move_red_left(h);
+
+      remove_min(h->m_left);
+
+      balance(h);
+   }
+
+   // The functions below expect h to be owned already.
+
+   void balance(node_ptr_t& h)
+   {
+      if (is_red(h->m_right))
+         rotate_left(h);
+      if (is_red(h->m_left) && is_red(h->m_left->m_left))
+         rotate_right(h);
+      if (is_red(h->m_left) && is_red(h->m_right))
+         flip_colors(h);
+      update_count(h);
+   }
+
+   void move_red_right(node_ptr_t& h)
+   {
+      flip_colors(h);
+      if (is_red(h->m_left->m_left))
+      {
+         rotate_right(h);
+         flip_colors(h);
+      }
+   }
+
+   void move_red_left(node_ptr_t& h)
+   {
+      flip_colors(h);
+      if (is_red(h->m_right->m_left))
+      {
+         rotate_right(h->m_right);
+         rotate_left(h);
+         flip_colors(h);
+      }
+   }
+
+   static bool is_red(const node_ptr_t& node)
+   {
+      return node && node->m_color == rb_color_t::red;
+   }
+
+   static void update_count(node_ptr_t& h)
+   {
+      h->m_count = 1 + node_count(h->m_left) + node_count(h->m_right);
+   }
+
+   void rotate(node_ptr_t& h, node_ptr_t node_t::* src,
+               node_ptr_t node_t::* dst)
+   {
+      node_ptr_t x = std::move((*h).*src);
+      own(x);
+      (*h).*src = std::move((*x).*dst);
+      x->m_color = h->m_color;
+      h->m_color = rb_color_t::red;
+      x->m_count = h->m_count;
+      update_count(h);
+      (*x).*dst = std::move(h);
+      h = std::move(x);
+   }
+
+   void rotate_right(node_ptr_t& h)
+   {
+      rotate(h, &node_t::m_left, &node_t::m_right);
+   }
+
+   void rotate_left(node_ptr_t& h)
+   {
+      rotate(h, &node_t::m_right, &node_t::m_left);
+   }
+
+   static rb_color_t flip_color(rb_color_t color)
+   {
+      return color == rb_color_t::red ? rb_color_t::black : rb_color_t::red;
+   }
+
+   void flip_colors(node_ptr_t& h)
+   {
+      assert(h->m_left);
+      assert(h->m_right);
+      own(h->m_left);
+      own(h->m_right);
+      h->m_color = flip_color(h->m_color);
+      h->m_left->m_color = flip_color(h->m_left->m_color);
+      h->m_right->m_color = flip_color(h->m_right->m_color);
+   }
+
+   static bool is_sound(const node_ptr_t& root)
+   {
+      std::size_t nb_black = 0;
+      for (auto link = &root; *link; link = &(*link)->m_left)
+         nb_black += !is_red(*link);
+      return is_node_sound(root, nb_black);
+   }
+
+   // nb_black is the number of black nodes expected on every path from h.
+   static bool is_node_sound(const node_ptr_t& h, std::size_t nb_black)
+   {
+      if (!h)
+         return nb_black == 0;
+      if (is_red(h->m_right) || (is_red(h) && is_red(h->m_left)))
+         return false;
+      if (h->m_count != 1 + node_count(h->m_left) + node_count(h->m_right))
+         return false;
+
+      if (!is_red(h))
+      {
+         if (nb_black == 0)
+            return false;
+         --nb_black;
+      }
+      return is_node_sound(h->m_left, nb_black) &&
+         is_node_sound(h->m_right, nb_black);
+   }
+};
+
+}
+
+// Left-leaning red-black tree whose nodes are never modified once reachable
+// from a published version: put and remove copy the O(log n) nodes on their
+// path and share all the others, through reference counting, with the
+// previous version. Copying the tree, or taking a snapshot, is O(1) and
+// versions nobody refers to any more are reclaimed automatically.
+//
+// One writer may update the tree while any number of threads take
+// snapshots of it and read those; writers must be serialized by the caller.
+// Only snapshot() and copies synchronize with the writer: get, rank, size
+// and the iterators read the current version as is, so on a tree being
+// updated they are for the writer thread, other threads use a snapshot.
+// Pointers and iterators stay valid as long as the version they come from.
+template <typename KeyType, typename ValueType,
+          typename LessType = std::less<KeyType>>
+class persistent_rb_tree_t
+{
+   using node_t = detail::prbt_node_t<KeyType, ValueType>;
+
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using less_t = LessType;
+   using const_iterator = detail::prbt_iterator_t<node_t>;
+   using iterator = const_iterator;
+
+   persistent_rb_tree_t(const LessType& less = LessType()):
+      m_less(less)
+   {}
+
+   persistent_rb_tree_t(const persistent_rb_tree_t& other):
+      m_root(std::atomic_load(&other.m_root)),
+      m_less(other.m_less)
+   {}
+
+   persistent_rb_tree_t& operator=(const persistent_rb_tree_t& other)
+   {
+      std::atomic_store(&m_root, std::atomic_load(&other.m_root));
+      m_less = other.m_less;
+      return *this;
+   }
+
+   // The current version, safe to call while the writer updates the tree.
+   persistent_rb_tree_t snapshot() const
+   {
+      return *this;
+   }
+
+   void put(const key_t& key, const value_t& value)
+   {
+      owner_t owner;
+      auto root = m_root;
+      impl_t(owner, m_less).put(root, key, value);
+      publish(std::move(root));
+   }
+
+   void remove(const key_t& key)
+   {
+      if (!get(key))
+         return;
+
+      owner_t owner;
+      auto root = m_root;
+      impl_t(owner, m_less).remove(root, key);
+      publish(std::move(root));
+   }
+
+   void clear()
+   {
+      publish(node_ptr_t());
+   }
+
+   // Writer thread or snapshot only, as the other reads below.
+   const value_t* get(const key_t& key) const
+   {
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+            node = node->m_left.get();
+         else if (m_less(node->m_key, key))
+            node = node->m_right.get();
+         else
+            return &node->m_value;
+      }
+      return nullptr;
+   }
+
+   // Number of keys strictly less than key.
+   std::size_t rank(const key_t& key) const
+   {
+      std::size_t r = 0;
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+         {
+            node = node->m_left.get();
+         }
+         else if (m_less(node->m_key, key))
+         {
+            r += 1 + detail::node_count(node->m_left);
+            node = node->m_right.get();
+         }
+         else
+         {
+            return r + detail::node_count(node->m_left);
+         }
+      }
+      return r;
+   }
+
+   std::size_t size() const
+   {
+      return detail::node_count(m_root);
+   }
+
+   const_iterator begin() const { return const_iterator(m_root.get()); }
+
+   const_iterator end() const { return const_iterator(); }
+
+private:
+   // Nodes of published versions are always referred to by their parent
+   // there, or by the tree for the root, so a node referred to once was
+   // created by the ongoing update.
+   struct owner_t
+   {
+      using node_ptr_t = typename node_t::ptr_t;
+
+      node_ptr_t make(const key_t& key, const value_t& value)
+      {
+         return std::make_shared<node_t>(key, value);
+      }
+
+      void own(node_ptr_t& node)
+      {
+         if (node.use_count() != 1)
+            node = std::make_shared<node_t>(*node);
+      }
+
+      void drop(node_ptr_t& node)
+      {
+         node.reset();
+      }
+   };
+
+   using node_ptr_t = typename owner_t::node_ptr_t;
+   using impl_t = detail::path_copy_rbt_t<owner_t, LessType>;
+
+   node_ptr_t m_root;
+   LessType m_less;
+
+   void publish(node_ptr_t root)
+   {
+      std::atomic_store(&m_root, std::move(root));
+   }
+};
+
+}
+
+#endif
@@ -2,7 +2,12 @@
 #define DATASTRUCTURES_RB_TREE_HPP
 
 #include <cassert>
+#include <cstddef>
 #include <functional>
+#include <future>
+#include <limits>
+#include <system_error>
+#include <thread>
 #include <utility>
 
 #include "ds/tree.hpp"
@@ -19,39 +24,587 @@ struct rbt_impl_t
    using node_ptr_t = typename node_trait_t<NodeType>::ptr_t;
    using key_t = typename node_trait_t<NodeType>::key_t;
    using value_t = typename node_trait_t<NodeType>::value_t;
+   using arena_t =
+      typename NodeType::alloc_t::template arena_t<NodeType>;
 
    rbt_impl_t(const LessType& less):
       m_less(less)
    {}
 
-   void put(node_ptr_t& root, const key_t& key, const value_t& value) const
+   // Creates a node out of key and args unless the key is already present.
+   // Returns the node holding the key and whether it was created.
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<NodeType*, bool> emplace(arena_t& arena, node_ptr_t& root,
+                                      KeyArgType&& key,
+                                      ArgTypes&&... args) const
    {
       assert(is_sound(root));
-      _put(root.get(), root, key, value);
-      root->m_color = NodeType::color_t::black;
+      const auto r = _emplace(arena, root.get(), root,
+                              std::forward<KeyArgType>(key),
+                              std::forward<ArgTypes>(args)...);
+      root->set_color(NodeType::color_t::black);
       assert(is_sound(root));
+      return r;
    }
 
-   void remove(node_ptr_t& root, const key_t& key) const
+   // Creates a node out of key and args in link, the empty link of parent
+   // where the key belongs, and returns it. The fix-ups of emplace are run
+   // bottom up through the parent links, without comparing keys.
+   template <typename KeyArgType, typename... ArgTypes>
+   NodeType* emplace_at(arena_t& arena, node_ptr_t& root, NodeType* parent,
+                        node_ptr_t& link, KeyArgType&& key,
+                        ArgTypes&&... args) const
    {
       assert(is_sound(root));
+      link = node_ptr_t(arena.create(parent, NodeType::color_t::red,
+                                     std::forward<KeyArgType>(key),
+                                     std::forward<ArgTypes>(args)...));
+      const auto node = link.get();
+      for (auto h = parent; h; h = h->parent())
+      {
+         auto& h_link = slot(root, h);
+         fix_up(h_link);
+         h = h_link.get();
+      }
+      root->set_color(NodeType::color_t::black);
+      assert(is_sound(root));
+      return node;
+   }
+
+   // Returns true when a node with the given key was found and removed.
+   template <typename KeyArgType>
+   bool remove(node_ptr_t& root, const KeyArgType& key) const
+   {
+      assert(is_sound(root));
+      if (!root)
+         return false;
+
       if (!is_red(root->m_left) && !is_red(root->m_right))
-         root->m_color = NodeType::color_t::red;
+         root->set_color(NodeType::color_t::red);
 
-      _remove(root, key);
+      const auto found = _remove(root, key);
 
       if (root)
-         root->m_color = NodeType::color_t::black;
+         root->set_color(NodeType::color_t::black);
+      assert(is_sound(root));
+      return found;
+   }
+
+   // Builds a valid left-leaning red-black tree out of n sorted elements in
+   // linear time, allocating the nodes in key order. The tree is shaped as a
+   // 2-3 tree of minimal height whose 3-nodes are black nodes with a red
+   // left child.
+   template <typename IteratorType>
+   static node_ptr_t build(arena_t& arena, IteratorType& it, std::size_t n)
+   {
+      std::size_t nb_black_links = 0;
+      while (n + 1 >= std::size_t(2) << nb_black_links)
+         ++nb_black_links;
+      return build(arena, it, n, nb_black_links);
+   }
+
+   // Links left, a new node (key, args) and right into left, in O(log n).
+   // The keys of left must be less than key, those of right greater; right
+   // is left empty.
+   template <typename KeyArgType, typename... ArgTypes>
+   void join(arena_t& arena, node_ptr_t& left, node_ptr_t& right,
+             KeyArgType&& key, ArgTypes&&... args) const
+   {
+      node_ptr_t node(arena.create(nullptr, NodeType::color_t::red,
+                                   std::forward<KeyArgType>(key),
+                                   std::forward<ArgTypes>(args)...));
+      join_around(left, std::move(node), right);
+   }
+
+   // Appends right, whose keys must all be greater than those of left, to
+   // left in O(log n). Its smallest node is unlinked to serve as the pivot.
+   void join(node_ptr_t& left, node_ptr_t& right) const
+   {
+      if (!right)
+         return;
+      if (!left)
+      {
+         left = std::move(right);
+         return;
+      }
+
+      if (!is_red(right->m_left) && !is_red(right->m_right))
+         right->set_color(NodeType::color_t::red);
+      auto pivot = remove_min(right);
+      if (right)
+      {
+         right->set_color(NodeType::color_t::black);
+         right->set_parent(nullptr);
+      }
+      join_around(left, std::move(pivot), right);
+   }
+
+   // Moves the nodes whose keys are not less than key from root to right,
+   // in O(log n).
+   template <typename KeyArgType>
+   void split(node_ptr_t& root, node_ptr_t& right,
+              const KeyArgType& key) const
+   {
+      assert(is_sound(root));
+      const auto height = black_height(root);
+      node_ptr_t left;
+      std::size_t left_height;
+      std::size_t right_height;
+      _split(std::move(root), height, key, left, left_height, right,
+             right_height);
+      root = std::move(left);
       assert(is_sound(root));
+      assert(is_sound(right));
+   }
+
+   // Replaces a with its union, intersection or difference with b, which is
+   // left empty. On equal keys a union keeps the node of b, the other
+   // operations that of a. The first depth levels of the recursion run
+   // their two halves concurrently, on subtrees large enough to pay for it.
+   void combine(node_ptr_t& a, node_ptr_t& b, set_op_t op,
+                unsigned depth) const
+   {
+      assert(is_sound(a));
+      assert(is_sound(b));
+      subtree_t ta;
+      ta.m_height = black_height(a);
+      ta.m_root = std::move(a);
+      subtree_t tb;
+      tb.m_height = black_height(b);
+      tb.m_root = std::move(b);
+      a = _combine(std::move(ta), std::move(tb), op, depth).m_root;
+      assert(is_sound(a));
    }
 
 private:
+   // Below this many nodes a subtree is not worth a thread.
+   static constexpr std::size_t parallel_grain = 1 << 14;
+
+   // A tree with a black root, and its black height.
+   struct subtree_t
+   {
+      node_ptr_t m_root;
+      std::size_t m_height = 0;
+   };
+
    LessType m_less;
 
+   void join_around(node_ptr_t& left, node_ptr_t node,
+                    node_ptr_t& right) const
+   {
+      assert(is_sound(left));
+      assert(is_sound(right));
+      std::size_t height;
+      left = _join(std::move(left), black_height(left), std::move(node),
+                   std::move(right), black_height(right), height);
+      assert(is_sound(left));
+   }
+
+   // Number of black nodes on every path from h down to a leaf.
+   static std::size_t black_height(const node_ptr_t& h)
+   {
+      std::size_t n = 0;
+      for (auto node = h.get(); node; node = node->m_left.get())
+      {
+         if (node->color() == NodeType::color_t::black)
+            ++n;
+      }
+      return n;
+   }
+
+   // Joins the trees left and right, of black heights left_height and
+   // right_height and with black roots, around node. The shorter tree hangs
+   // off the spine of the taller one, at the black node of its height, and
+   // the path above is rebalanced as after an insertion: the cost is
+   // O(1 + |left_height - right_height|). height receives the black height
+   // of the result.
+   static node_ptr_t _join(node_ptr_t left, std::size_t left_height,
+                           node_ptr_t node, node_ptr_t right,
+                           std::size_t right_height, std::size_t& height)
+   {
+      node->set_color(NodeType::color_t::red);
+      node_ptr_t root;
+      if (left_height > right_height)
+      {
+         join_right(left, left_height, node, right, right_height);
+         root = std::move(left);
+         height = left_height;
+      }
+      else if (left_height < right_height)
+      {
+         join_left(right, right_height, node, left, left_height);
+         root = std::move(right);
+         height = right_height;
+      }
+      else
+      {
+         attach(node, std::move(left), std::move(right));
+         root = std::move(node);
+         height = left_height;
+      }
+
+      if (is_red(root))
+      {
+         root->set_color(NodeType::color_t::black);
+         ++height;
+      }
+      root->set_parent(nullptr);
+      return root;
+   }
+
+   // Goes down the right spine of h, whose links are all black. The caller
+   // sets the parent of the new h.
+   static void join_right(node_ptr_t& h, std::size_t height, node_ptr_t& node,
+                          node_ptr_t& right, std::size_t right_height)
+   {
+      if (height == right_height && !is_red(h))
+      {
+         attach(node, std::move(h), std::move(right));
+         h = std::move(node);
+         return;
+      }
+
+      join_right(h->m_right, is_red(h) ? height : height - 1, node, right,
+                 right_height);
+      h->m_right->set_parent(h.get());
+      fix_up(h);
+   }
+
+   // Goes down the left spine of h, skipping its red nodes.
+   static void join_left(node_ptr_t& h, std::size_t height, node_ptr_t& node,
+                         node_ptr_t& left, std::size_t left_height)
+   {
+      if (height == left_height && !is_red(h))
+      {
+         attach(node, std::move(left), std::move(h));
+         h = std::move(node);
+         return;
+      }
+
+      join_left(h->m_left, is_red(h) ? height : height - 1, node, left,
+                left_height);
+      h->m_left->set_parent(h.get());
+      fix_up(h);
+   }
+
+   // Takes the subtree of link out as a tree of its own, with a black root,
+   // given the black height of its parent.
+   static node_ptr_t take_subtree(node_ptr_t& link, bool parent_is_black,
+                                  std::size_t parent_height,
+                                  std::size_t& height)
+   {
+      auto h = std::move(link);
+      height = parent_is_black ? parent_height - 1 : parent_height;
+      if (h)
+      {
+         h->set_parent(nullptr);
+         if (is_red(h))
+         {
+            h->set_color(NodeType::color_t::black);
+            ++height;
+         }
+      }
+      return h;
+   }
+
+   // Splits h, of black height height, in the trees of the keys less than
+   // key and of the others. Each node on the search path is joined back to
+   // the side it belongs to with the subtree it keeps; the joins cost the
+   // differences of black heights, which add up to O(log n). With found,
+   // the node holding key, if any, is kept out of both trees.
+   template <typename KeyArgType>
+   void _split(node_ptr_t h, std::size_t height, const KeyArgType& key,
+               node_ptr_t& left, std::size_t& left_height,
+               node_ptr_t& right, std::size_t& right_height,
+               node_ptr_t* found = nullptr) const
+   {
+      if (!h)
+      {
+         left_height = right_height = 0;
+         return;
+      }
+
+      const auto black = !is_red(h);
+      std::size_t l_height;
+      std::size_t r_height;
+      auto l = take_subtree(h->m_left, black, height, l_height);
+      auto r = take_subtree(h->m_right, black, height, r_height);
+
+      node_ptr_t mid;
+      std::size_t mid_height;
+      if (m_less(h->m_key, key))
+      {
+         _split(std::move(r), r_height, key, mid, mid_height, right,
+                right_height, found);
+         left = _join(std::move(l), l_height, std::move(h), std::move(mid),
+                      mid_height, left_height);
+      }
+      else if (m_less(key, h->m_key))
+      {
+         _split(std::move(l), l_height, key, left, left_height, mid,
+                mid_height, found);
+         right = _join(std::move(mid), mid_height, std::move(h),
+                       std::move(r), r_height, right_height);
+      }
+      else if (found)
+      {
+         left = std::move(l);
+         left_height = l_height;
+         right = std::move(r);
+         right_height = r_height;
+         *found = std::move(h);
+      }
+      else
+      {
+         left = std::move(l);
+         left_height = l_height;
+         right = _join(node_ptr_t(), 0, std::move(h), std::move(r),
+                       r_height, right_height);
+      }
+   }
+
+   // Join-based set operation: the root of the smaller tree splits the
+   // other one, the halves on each side are combined and joined back around
+   // the node kept for the root key, if any. The work is O(m log(n/m + 1))
+   // for sizes m <= n, and the two halves are independent.
+   subtree_t _combine(subtree_t a, subtree_t b, set_op_t op,
+                      unsigned depth) const
+   {
+      if (!a.m_root || !b.m_root)
+      {
+         if (op == set_op_t::intersect)
+            return subtree_t();
+         if (op == set_op_t::subtract || !b.m_root)
+            return a;
+         return b;
+      }
+
+      const auto size = node_count(a.m_root) + node_count(b.m_root);
+      subtree_t a_left, a_right, b_left, b_right;
+      node_ptr_t in_a, in_b;
+      if (node_count(a.m_root) < node_count(b.m_root))
+      {
+         expose(a, in_a, a_left, a_right);
+         _split(std::move(b.m_root), b.m_height, in_a->m_key,
+                b_left.m_root, b_left.m_height, b_right.m_root,
+                b_right.m_height, &in_b);
+      }
+      else
+      {
+         expose(b, in_b, b_left, b_right);
+         _split(std::move(a.m_root), a.m_height, in_b->m_key,
+                a_left.m_root, a_left.m_height, a_right.m_root,
+                a_right.m_height, &in_a);
+      }
+
+      const auto next = depth ? depth - 1 : 0;
+      subtree_t left, right;
+      fork(depth > 0 && size >= parallel_grain,
+           [&] {
+              left = _combine(std::move(a_left), std::move(b_left), op, next);
+           },
+           [&] {
+              right = _combine(std::move(a_right), std::move(b_right), op,
+                               next);
+           });
+
+      // the nodes left behind are freed on return
+      node_ptr_t node;
+      if (op == set_op_t::unite)
+         node = std::move(in_b ? in_b : in_a);
+      else if (op == set_op_t::intersect ? bool(in_b) : !in_b)
+         node = std::move(in_a);
+
+      if (node)
+         return join(std::move(left), std::move(node), std::move(right));
+      return concat(std::move(left), std::move(right));
+   }
+
+   // Runs left and right, concurrently if asked to and a thread can be had.
+   template <typename LeftFunType, typename RightFunType>
+   static void fork(bool parallel, LeftFunType left, RightFunType right)
+   {
+      std::future<void> task;
+      if (parallel)
+      {
+         try
+         {
+            task = std::async(std::launch::async, left);
+         }
+         catch (const std::system_error&)
+         {
+         }
+      }
+
+      if (!task.valid())
+         left();
+      right();
+      if (task.valid())
+         task.get();
+   }
+
+   // Takes t apart into its root node and the subtrees of its children.
+   static void expose(subtree_t& t, node_ptr_t& node, subtree_t& left,
+                      subtree_t& right)
+   {
+      node = std::move(t.m_root);
+      left.m_root = take_subtree(node->m_left, true, t.m_height,
+                                 left.m_height);
+      right.m_root = take_subtree(node->m_right, true, t.m_height,
+                                  right.m_height);
+   }
+
+   static subtree_t join(subtree_t left, node_ptr_t node, subtree_t right)
+   {
+      subtree_t t;
+      t.m_root = _join(std::move(left.m_root), left.m_height,
+                       std::move(node), std::move(right.m_root),
+                       right.m_height, t.m_height);
+      return t;
+   }
+
+   // Joins left and right around the smallest node of right.
+   static subtree_t concat(subtree_t left, subtree_t right)
+   {
+      if (!left.m_root)
+         return right;
+      if (!right.m_root)
+         return left;
+
+      auto& r = right.m_root;
+      if (!is_red(r->m_left) && !is_red(r->m_right))
+         r->set_color(NodeType::color_t::red);
+      auto pivot = remove_min(r);
+      if (r)
+      {
+         r->set_color(NodeType::color_t::black);
+         r->set_parent(nullptr);
+      }
+      right.m_height = black_height(r);
+      return join(std::move(left), std::move(pivot), std::move(right));
+   }
+
+   // The link that owns h.
+   static node_ptr_t& slot(node_ptr_t& root, NodeType* h)
+   {
+      const auto p = h->parent();
+      if (!p)
+         return root;
+      return p->m_left.get() == h ? p->m_left : p->m_right;
+   }
+
+   // Restores the invariants at h once one of its children got a red link,
+   // as on the way up from an insertion.
+   static void fix_up(node_ptr_t& h)
+   {
+      if (is_red(h->m_right) && !is_red(h->m_left))
+         rotate_left(h);
+
+      if (is_red(h->m_left) && is_red(h->m_left->m_left))
+         rotate_right(h);
+
+      if (is_red(h->m_left) && is_red(h->m_right))
+         flip_colors(h);
+
+      update_count(h);
+   }
+
+   // Largest number of keys a 2-3 tree with the given black height can hold,
+   // saturated on overflow.
+   static std::size_t max_nb_keys(std::size_t nb_black_links)
+   {
+      std::size_t n = 1;
+      for (std::size_t i = 0; i < nb_black_links; ++i)
+      {
+         if (n > std::numeric_limits<std::size_t>::max() / 3)
+            return std::numeric_limits<std::size_t>::max();
+         n *= 3;
+      }
+      return n - 1;
+   }
+
+   template <typename IteratorType>
+   static node_ptr_t build(arena_t& arena, IteratorType& it, std::size_t n,
+                           std::size_t nb_black_links)
+   {
+      if (n == 0)
+      {
+         assert(nb_black_links == 0);
+         return node_ptr_t();
+      }
+
+      assert(nb_black_links > 0);
+      const auto max_child = max_nb_keys(nb_black_links - 1);
+      if ((n - 1) / 2 <= max_child && n - 1 - (n - 1) / 2 <= max_child)
+      {
+         auto left = build(arena, it, (n - 1) / 2, nb_black_links - 1);
+         auto h = make_node(arena, it, NodeType::color_t::black);
+         auto right = build(arena, it, n - 1 - (n - 1) / 2,
+                            nb_black_links - 1);
+         attach(h, std::move(left), std::move(right));
+         return h;
+      }
+
+      const auto n_left = (n - 2) / 3;
+      const auto n_mid = (n - 2 - n_left) / 2;
+      const auto n_right = n - 2 - n_left - n_mid;
+
+      auto left = build(arena, it, n_left, nb_black_links - 1);
+      auto r = make_node(arena, it, NodeType::color_t::red);
+      auto mid = build(arena, it, n_mid, nb_black_links - 1);
+      attach(r, std::move(left), std::move(mid));
+
+      auto h = make_node(arena, it, NodeType::color_t::black);
+      auto right = build(arena, it, n_right, nb_black_links - 1);
+      attach(h, std::move(r), std::move(right));
+      return h;
+   }
+
+   template <typename IteratorType>
+   static node_ptr_t make_node(arena_t& arena, IteratorType& it,
+                               typename NodeType::color_t color)
+   {
+      node_ptr_t node(arena.create(nullptr, color, (*it).first,
+                                   (*it).second));
+      ++it;
+      return node;
+   }
+
+   // Takes over a node unlinked from a tree instead of creating one.
+   static node_ptr_t make_node(arena_t&, node_ptr_t*& it,
+                               typename NodeType::color_t color)
+   {
+      auto node = std::move(*it);
+      ++it;
+      node->set_parent(nullptr);
+      node->set_color(color);
+      return node;
+   }
+
+   static void attach(node_ptr_t& h, node_ptr_t left, node_ptr_t right)
+   {
+      h->m_left = std::move(left);
+      h->m_right = std::move(right);
+      if (h->m_left)
+         h->m_left->set_parent(h.get());
+      if (h->m_right)
+         h->m_right->set_parent(h.get());
+      update_count(h);
+   }
+
 
    bool is_sound(const node_ptr_t& root) const
    {
-      return is_node_sound(root) && is_balanced(root);
+      return is_node_sound(root) && is_balanced(root) && is_counted(root);
+   }
+
+   static bool is_counted(const node_ptr_t& h)
+   {
+      if (!h)
+         return true;
+      if (h->m_count != 1 + node_count(h->m_left) + node_count(h->m_right))
+         return false;
+      return is_counted(h->m_left) && is_counted(h->m_right);
    }
 
    static bool is_node_sound(const node_ptr_t& h)
@@ -63,10 +616,10 @@ private:
       if (is_red(h) && is_red(h->m_left))
          return false;
 
-      if (h->m_left && h.get() != h->m_left->m_parent)
+      if (h->m_left && h.get() != h->m_left->parent())
          return false;
 
-      if (h->m_right && h.get() != h->m_right->m_parent)
+      if (h->m_right && h.get() != h->m_right->parent())
          return false;
 
       return is_node_sound(h->m_left) && is_node_sound(h->m_right);
@@ -99,92 +652,110 @@ private:
          _is_balanced(h->m_right, expected_nb_black_links, nb_black_links);
    }
 
-   void _put(NodeType* parent, node_ptr_t& node, 
-             const key_t& key, const value_t& value) const
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<NodeType*, bool> _emplace(arena_t& arena, NodeType* parent,
+                                       node_ptr_t& node, KeyArgType&& key,
+                                       ArgTypes&&... args) const
    {
       if (!node)
       {
-         node = node_ptr_t(new NodeType(parent, key, value, 
-                                        NodeType::color_t::red));
-         return;
+         node = node_ptr_t(arena.create(parent, NodeType::color_t::red,
+                                        std::forward<KeyArgType>(key),
+                                        std::forward<ArgTypes>(args)...));
+         return std::make_pair(node.get(), true);
       }
 	   
+      auto r = std::make_pair(node.get(), false);
       if (m_less(key, node->m_key))
-         _put(node.get(), node->m_left, key, value);
+         r = _emplace(arena, node.get(), node->m_left,
+                      std::forward<KeyArgType>(key),
+                      std::forward<ArgTypes>(args)...);
       else if (m_less(node->m_key, key))
-         _put(node.get(), node->m_right, key, value);
-      else
-         node->m_value = value;
-
-      if (is_red(node->m_right) && !is_red(node->m_left))
-         rotate_left(node);
+         r = _emplace(arena, node.get(), node->m_right,
+                      std::forward<KeyArgType>(key),
+                      std::forward<ArgTypes>(args)...);
 
-      if (is_red(node->m_left) && is_red(node->m_left->m_left))
-         rotate_right(node);
-
-      if (is_red(node->m_left) && is_red(node->m_right))
-         flip_colors(node);
+      fix_up(node);
+      return r;
    }
 
 
-   void _remove(node_ptr_t& h, const key_t& key) const
+   // Returns whether the key was found. The descent keeps the current node
+   // out of a 2-node either way, and balance undoes it on the way up, so a
+   // missing key needs no search beforehand.
+   template <typename KeyArgType>
+   bool _remove(node_ptr_t& h, const KeyArgType& key) const
    {
+      bool found;
       if (m_less(key, h->m_key))
       {
-         assert(h->m_left);
+         if (!h->m_left)
+            return false;
          if (!is_red(h->m_left) && !is_red(h->m_left->m_left))
             move_red_left(h);
 
-         _remove(h->m_left, key);
+         found = _remove(h->m_left, key);
       }
       else
       {
          if (is_red(h->m_left))
             rotate_right(h);
 
-         if (key_equal(key, h->m_key) && !h->m_right)
+         if (!h->m_right)
          {
+            if (!key_equal(key, h->m_key))
+               return false;
             h.reset();
-            return;
+            return true;
          }
 
-         assert(h->m_right);
          if (!is_red(h->m_right) && !is_red(h->m_right->m_left))
             move_red_right(h);
 
          if (key_equal(key, h->m_key))
          {
-            const auto& node_min = find_min(h->m_right);
-            h->m_value = node_min->m_value;
-            h->m_key = node_min->m_key;
-            remove_min(h->m_right);
+            // the successor node takes the place of h, so that iterators
+            // to it stay valid
+            auto node_min = remove_min(h->m_right);
+            assert(!node_min->m_right);
+            node_min->m_left = std::move(h->m_left);
+            node_min->m_right = std::move(h->m_right);
+            if (node_min->m_left)
+               node_min->m_left->set_parent(node_min.get());
+            if (node_min->m_right)
+               node_min->m_right->set_parent(node_min.get());
+            node_min->set_parent(h->parent());
+            node_min->set_color(h->color());
+            h = std::move(node_min);
+            found = true;
          }
          else
-            _remove(h->m_right, key);
+            found = _remove(h->m_right, key);
       }
 
       balance(h);
+      return found;
    }
 
-   static void remove_min(node_ptr_t& h)
+   // Unlinks the smallest node of h and returns it.
+   static node_ptr_t remove_min(node_ptr_t& h)
    {
       assert(h);
       if (!h->m_left)
-      {
-         h.reset();
-         return;
-      }
+         return std::move(h);
 
       assert(h->m_left);
       if (!is_red(h->m_left) && !is_red(h->m_left->m_left))
          move_red_left(h);
 
-      remove_min(h->m_left);
+      auto min = remove_min(h->m_left);
 
       balance(h);
+      return min;
    }
 
-   bool key_equal(const key_t& lhs, const key_t& rhs) const
+   template <typename KeyArgType>
+   bool key_equal(const KeyArgType& lhs, const key_t& rhs) const
    {
       return !m_less(lhs, rhs) && !m_less(rhs, lhs);
    }
@@ -197,13 +768,7 @@ private:
          rotate_right(h);
       if (is_red(h->m_left) && is_red(h->m_right))
          flip_colors(h);
-   }
-
-   static node_ptr_t& find_min(node_ptr_t& node)
-   {
-      if (!node || !node->m_left)
-         return node;
-      return find_min(node->m_left);
+      update_count(h);
    }
 
    static void move_red_right(node_ptr_t& h)
@@ -233,24 +798,29 @@ private:
    {
       if (!node)
          return false;
-      return node->m_color == NodeType::color_t::red;
+      return node->color() == NodeType::color_t::red;
    }
 
    static void rotate(node_ptr_t& h, node_ptr_t NodeType::* src, 
                       node_ptr_t NodeType::* dst)
    {
-      auto p = h->m_parent;
+#ifdef DS_TREE_STATS
+      tree_stats_t::rotations().fetch_add(1, std::memory_order_relaxed);
+#endif
+      auto p = h->parent();
       node_ptr_t x = std::move((*h).*src);
       (*h).*src = std::move((*x).*dst);
       if ((*h).*src)
-         ((*h).*src)->m_parent = h.get();
-      x->m_color = h->m_color;
-      h->m_color = NodeType::color_t::red;
+         ((*h).*src)->set_parent(h.get());
+      x->set_color(h->color());
+      h->set_color(NodeType::color_t::red);
+      x->m_count = h->m_count;
+      update_count(h);
       (*x).*dst = std::move(h);
       if ((*x).*dst)
-         ((*x).*dst)->m_parent = x.get();
+         ((*x).*dst)->set_parent(x.get());
       h = std::move(x);
-      h->m_parent = p;
+      h->set_parent(p);
    }
 
    static void rotate_right(node_ptr_t& h)
@@ -272,43 +842,138 @@ private:
 
    static void flip_colors(node_ptr_t& h)
    {
-      h->m_color = flip_color(h->m_color);
+      h->set_color(flip_color(h->color()));
       assert(h->m_left);
       assert(h->m_right);
-      h->m_left->m_color = flip_color(h->m_left->m_color);
-      h->m_right->m_color = flip_color(h->m_right->m_color);
+      h->m_left->set_color(flip_color(h->m_left->color()));
+      h->m_right->set_color(flip_color(h->m_right->color()));
    }
 
 };
 
+enum class rb_color_t { red, black };
 
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType, typename AllocType>
 struct rbt_node_t: public node_base_t<KeyType, ValueType,
-                                      rbt_node_t<KeyType, ValueType>>
+                                      rbt_node_t<KeyType, ValueType, AllocType>>
 {
    using base_t = node_base_t<KeyType, ValueType,
-                              rbt_node_t<KeyType, ValueType>>;
-
-   enum class color_t { red, black };
-
-   rbt_node_t(rbt_node_t* parent, const KeyType& key, const ValueType& value, 
-              typename rbt_node_t::color_t color):
-      base_t(parent, key, value),
+                              rbt_node_t<KeyType, ValueType, AllocType>>;
+   using alloc_t = AllocType;
+   using color_t = rb_color_t;
+
+   template <typename KeyArgType, typename... ValueArgTypes>
+   rbt_node_t(rbt_node_t* parent, color_t color,
+              KeyArgType&& key, ValueArgTypes&&... args):
+      base_t(parent, std::forward<KeyArgType>(key),
+             std::forward<ValueArgTypes>(args)...),
       m_color(color)
    {}
 
+   color_t color() const
+   {
+      return m_color;
+   }
+
+   void set_color(color_t color)
+   {
+      m_color = color;
+   }
+
    color_t m_color = color_t::red;
 };
 
+// Same node with the color packed into the parent pointer.
+template <typename KeyType, typename ValueType, typename AllocType>
+struct rbt_compact_node_t:
+   public compact_node_base_t<KeyType, ValueType,
+                              rbt_compact_node_t<KeyType, ValueType, AllocType>>
+{
+   using base_t =
+      compact_node_base_t<KeyType, ValueType,
+                          rbt_compact_node_t<KeyType, ValueType, AllocType>>;
+   using alloc_t = AllocType;
+   using color_t = rb_color_t;
+
+   template <typename KeyArgType, typename... ValueArgTypes>
+   rbt_compact_node_t(rbt_compact_node_t* parent, color_t color,
+                      KeyArgType&& key, ValueArgTypes&&... args):
+      base_t(parent, color == color_t::black, std::forward<KeyArgType>(key),
+             std::forward<ValueArgTypes>(args)...)
+   {}
+
+   color_t color() const
+   {
+      return this->tag() ? color_t::black : color_t::red;
+   }
+
+   void set_color(color_t color)
+   {
+      this->set_tag(color == color_t::black);
+   }
+};
+
 }
 
 template<typename KeyType, typename ValueType,
-         typename LessType = std::less<KeyType>>
+         typename LessType = std::less<KeyType>,
+         typename AllocType = heap_alloc_t>
    using rb_tree_t =
-   detail::tree_t<detail::rbt_node_t<KeyType, ValueType>, LessType,
-                  detail::rbt_impl_t<detail::rbt_node_t<KeyType, ValueType>,
+   detail::tree_t<detail::rbt_node_t<KeyType, ValueType, AllocType>, LessType,
+                  detail::rbt_impl_t<detail::rbt_node_t<KeyType, ValueType,
+                                                        AllocType>,
+                                     LessType>>;
+
+// rb_tree_t over rbt_compact_node_t: smaller nodes, same operations.
+template<typename KeyType, typename ValueType,
+         typename LessType = std::less<KeyType>,
+         typename AllocType = heap_alloc_t>
+   using compact_rb_tree_t =
+   detail::tree_t<detail::rbt_compact_node_t<KeyType, ValueType, AllocType>,
+                  LessType,
+                  detail::rbt_impl_t<detail::rbt_compact_node_t<KeyType,
+                                                                ValueType,
+                                                                AllocType>,
                                      LessType>>;
 
+// Union of the elements of a and b, built out of their nodes so that both
+// trees are consumed, in O(m log(n/m + 1)) for sizes m <= n. On equal keys
+// the element of b is kept, which makes b a batch of updates to a. The
+// recursion spreads over up to nb_threads threads. Elements are lost if a
+// comparison throws.
+template <typename NodeType, typename LessType, typename ImplType>
+detail::tree_t<NodeType, LessType, ImplType>
+set_union(detail::tree_t<NodeType, LessType, ImplType> a,
+          detail::tree_t<NodeType, LessType, ImplType> b,
+          std::size_t nb_threads = std::thread::hardware_concurrency())
+{
+   a.combine(b, set_op_t::unite, nb_threads);
+   return a;
+}
+
+// Elements of a whose keys are in b, as set_union.
+template <typename NodeType, typename LessType, typename ImplType>
+detail::tree_t<NodeType, LessType, ImplType>
+set_intersection(detail::tree_t<NodeType, LessType, ImplType> a,
+                 detail::tree_t<NodeType, LessType, ImplType> b,
+                 std::size_t nb_threads =
+                    std::thread::hardware_concurrency())
+{
+   a.combine(b, set_op_t::intersect, nb_threads);
+   return a;
+}
+
+// Elements of a whose keys are not in b, as set_union.
+template <typename NodeType, typename LessType, typename ImplType>
+detail::tree_t<NodeType, LessType, ImplType>
+set_difference(detail::tree_t<NodeType, LessType, ImplType> a,
+               detail::tree_t<NodeType, LessType, ImplType> b,
+               std::size_t nb_threads = std::thread::hardware_concurrency())
+{
+   a.combine(b, set_op_t::subtract, nb_threads);
+   return a;
+}
+
 }
 
 #endif
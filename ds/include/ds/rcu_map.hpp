@@ -0,0 +1,290 @@
+#ifndef DATASTRUCTURES_RCU_MAP_HPP
+#define DATASTRUCTURES_RCU_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ds/epoch.hpp"
+#include "ds/persistent_rb_tree.hpp"
+
+namespace ds
+{
+
+namespace detail
+{
+
+template <typename KeyType, typename ValueType>
+struct rcu_node_t
+{
+   rcu_node_t(const KeyType& key, const ValueType& value,
+              std::uint64_t version):
+      m_key(key),
+      m_value(value),
+      m_version(version)
+   {}
+
+   rcu_node_t* m_left = nullptr;
+   rcu_node_t* m_right = nullptr;
+   KeyType m_key;
+   ValueType m_value;
+   std::size_t m_count = 1;
+   rb_color_t m_color = rb_color_t::red;
+   // update that created the node
+   std::uint64_t m_version;
+};
+
+}
+
+// Ordered map for many readers and few writers. Readers never lock: they
+// announce an epoch and walk the current version of a left-leaning
+// red-black tree. Writers are serialized; each one copies the path it
+// changes, as persistent_rb_tree_t does, publishes the new root atomically
+// and retires the replaced nodes, freed once the readers that may still
+// see them are done.
+//
+// Lookups copy the value out, as no reference can outlive the read.
+template <typename KeyType, typename ValueType,
+          typename LessType = std::less<KeyType>>
+class rcu_map_t
+{
+   using node_t = detail::rcu_node_t<KeyType, ValueType>;
+   using guard_t = detail::epoch_domain_t::guard_t;
+
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using less_t = LessType;
+
+   rcu_map_t(const LessType& less = LessType()):
+      m_less(less)
+   {}
+
+   // No reader nor writer may be left.
+   ~rcu_map_t()
+   {
+      destroy(m_root.load());
+      for (auto& r : m_limbo)
+      {
+         for (auto node : r.m_nodes)
+            delete node;
+      }
+   }
+
+   rcu_map_t(const rcu_map_t&) = delete;
+   rcu_map_t& operator=(const rcu_map_t&) = delete;
+
+   void put(const key_t& key, const value_t& value)
+   {
+      std::lock_guard<std::mutex> lock(m_write_mutex);
+      update([&](impl_t& impl, node_t*& root) {
+         impl.put(root, key, value);
+      });
+   }
+
+   void remove(const key_t& key)
+   {
+      std::lock_guard<std::mutex> lock(m_write_mutex);
+      if (!contains(key))
+         return;
+      update([&](impl_t& impl, node_t*& root) {
+         impl.remove(root, key);
+      });
+   }
+
+   // Copies the value of key, if present, to value.
+   bool get(const key_t& key, value_t& value) const
+   {
+      guard_t guard;
+      const auto node = find(key);
+      if (!node)
+         return false;
+      value = node->m_value;
+      return true;
+   }
+
+   bool contains(const key_t& key) const
+   {
+      guard_t guard;
+      return find(key) != nullptr;
+   }
+
+   // Number of keys strictly less than key.
+   std::size_t rank(const key_t& key) const
+   {
+      guard_t guard;
+      std::size_t r = 0;
+      auto node = m_root.load();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+         {
+            node = node->m_left;
+         }
+         else if (m_less(node->m_key, key))
+         {
+            r += 1 + detail::node_count(node->m_left);
+            node = node->m_right;
+         }
+         else
+         {
+            return r + detail::node_count(node->m_left);
+         }
+      }
+      return r;
+   }
+
+   std::size_t size() const
+   {
+      guard_t guard;
+      return detail::node_count(m_root.load());
+   }
+
+   // Calls f(key, value) on every element of one version, in key order.
+   template <typename FunType>
+   void for_each(FunType f) const
+   {
+      guard_t guard;
+      for_each(m_root.load(), f);
+   }
+
+private:
+   // Nodes created by the ongoing update carry its version, the others
+   // are copied and the originals retired.
+   struct owner_t
+   {
+      using node_ptr_t = node_t*;
+
+      std::uint64_t m_version = 0;
+      std::vector<node_t*> m_retired;
+      std::vector<node_t*> m_created;
+      std::vector<node_t*> m_dropped;
+
+      // the slot is taken first, so that no node can leak
+      node_t* make(const key_t& key, const value_t& value)
+      {
+         m_created.push_back(nullptr);
+         m_created.back() = new node_t(key, value, m_version);
+         return m_created.back();
+      }
+
+      void own(node_t*& node)
+      {
+         if (node->m_version == m_version)
+            return;
+         m_created.push_back(nullptr);
+         m_created.back() = new node_t(*node);
+         m_created.back()->m_version = m_version;
+         m_retired.push_back(node);
+         node = m_created.back();
+      }
+
+      void drop(node_t*& node)
+      {
+         m_dropped.push_back(node);
+         node = nullptr;
+      }
+   };
+
+   using impl_t = detail::path_copy_rbt_t<owner_t, LessType>;
+
+   struct retired_t
+   {
+      std::uint64_t m_epoch;
+      std::vector<node_t*> m_nodes;
+   };
+
+   std::atomic<node_t*> m_root{nullptr};
+   LessType m_less;
+   std::mutex m_write_mutex;
+   owner_t m_owner;
+   std::deque<retired_t> m_limbo;
+
+   node_t* find(const key_t& key) const
+   {
+      auto node = m_root.load();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+            node = node->m_left;
+         else if (m_less(node->m_key, key))
+            node = node->m_right;
+         else
+            return node;
+      }
+      return nullptr;
+   }
+
+   template <typename FunType>
+   static void for_each(const node_t* node, FunType& f)
+   {
+      for (; node; node = node->m_right)
+      {
+         for_each(node->m_left, f);
+         f(node->m_key, node->m_value);
+      }
+   }
+
+   // Builds the next version with fun, publishes it and retires the nodes
+   // it replaced. On failure the current version is left untouched.
+   template <typename FunType>
+   void update(FunType fun)
+   {
+      ++m_owner.m_version;
+      m_owner.m_retired.clear();
+      m_owner.m_created.clear();
+      m_owner.m_dropped.clear();
+
+      auto root = m_root.load();
+      try
+      {
+         impl_t impl(m_owner, m_less);
+         fun(impl, root);
+      }
+      catch (...)
+      {
+         for (auto node : m_owner.m_created)
+            delete node;
+         throw;
+      }
+
+      m_root.store(root);
+      for (auto node : m_owner.m_dropped)
+         delete node;
+
+      auto& domain = detail::epoch_domain_t::instance();
+      m_limbo.push_back(retired_t{domain.advance(),
+                                  std::move(m_owner.m_retired)});
+      reclaim(domain.oldest());
+   }
+
+   void reclaim(std::uint64_t oldest)
+   {
+      while (!m_limbo.empty() && m_limbo.front().m_epoch < oldest)
+      {
+         for (auto node : m_limbo.front().m_nodes)
+            delete node;
+         m_limbo.pop_front();
+      }
+   }
+
+   static void destroy(node_t* node)
+   {
+      while (node)
+      {
+         destroy(node->m_left);
+         auto right = node->m_right;
+         delete node;
+         node = right;
+      }
+   }
+};
+
+}
+
+#endif
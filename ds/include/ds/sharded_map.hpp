@@ -0,0 +1,184 @@
+#ifndef DATASTRUCTURES_SHARDED_MAP_HPP
+#define DATASTRUCTURES_SHARDED_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ds/priority_queue.hpp"
+#include "ds/rb_tree.hpp"
+
+namespace ds
+{
+
+// Ordered map for concurrent use, made of independently locked trees. Keys
+// are spread over the shards by hash, so that threads working on different
+// keys seldom wait for each other. Ordered iteration merges the shards.
+//
+// Lookups copy the value out, as no reference can outlive the lock.
+template <typename KeyType, typename ValueType,
+          typename TreeType = rb_tree_t<KeyType, ValueType>,
+          typename HashType = std::hash<KeyType>>
+class sharded_map_t
+{
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using tree_t = TreeType;
+
+   // The number of shards is rounded up to a power of two. The default
+   // leaves a few per hardware thread.
+   explicit sharded_map_t(std::size_t nb_shards = default_nb_shards(),
+                          const HashType& hash = HashType()):
+      m_hash(hash)
+   {
+      while ((std::size_t(1) << m_bits) < nb_shards)
+         ++m_bits;
+      m_nb_shards = std::size_t(1) << m_bits;
+      m_shards.reset(new shard_t[m_nb_shards]);
+   }
+
+   sharded_map_t(const sharded_map_t&) = delete;
+   sharded_map_t& operator=(const sharded_map_t&) = delete;
+
+   void put(const key_t& key, const value_t& value)
+   {
+      auto& shard = shard_of(key);
+      std::lock_guard<std::mutex> lock(shard.m_mutex);
+      shard.m_tree.put(key, value);
+   }
+
+   void remove(const key_t& key)
+   {
+      auto& shard = shard_of(key);
+      std::lock_guard<std::mutex> lock(shard.m_mutex);
+      shard.m_tree.remove(key);
+   }
+
+   // Copies the value of key, if present, to value.
+   bool get(const key_t& key, value_t& value) const
+   {
+      auto& shard = shard_of(key);
+      std::lock_guard<std::mutex> lock(shard.m_mutex);
+      const auto v = shard.m_tree.get(key);
+      if (!v)
+         return false;
+      value = *v;
+      return true;
+   }
+
+   bool contains(const key_t& key) const
+   {
+      auto& shard = shard_of(key);
+      std::lock_guard<std::mutex> lock(shard.m_mutex);
+      return shard.m_tree.get(key) != nullptr;
+   }
+
+   // Sum of the shard sizes, each read under its own lock.
+   std::size_t size() const
+   {
+      std::size_t n = 0;
+      for (std::size_t i = 0; i < m_nb_shards; ++i)
+      {
+         std::lock_guard<std::mutex> lock(m_shards[i].m_mutex);
+         n += m_shards[i].m_tree.size();
+      }
+      return n;
+   }
+
+   std::size_t nb_shards() const
+   {
+      return m_nb_shards;
+   }
+
+   // Calls f(key, value) on every element in key order, merging the shards
+   // through a heap of their smallest remaining keys. All the shards stay
+   // locked meanwhile, so f sees one state of the map and must not use it.
+   template <typename FunType>
+   void for_each(FunType f) const
+   {
+      std::vector<std::unique_lock<std::mutex>> locks;
+      locks.reserve(m_nb_shards);
+      for (std::size_t i = 0; i < m_nb_shards; ++i)
+         locks.emplace_back(m_shards[i].m_mutex);
+
+      priority_queue<cursor_t, cursor_less_t> heads(
+         cursor_less_t{m_shards[0].m_tree.key_comp()});
+      for (std::size_t i = 0; i < m_nb_shards; ++i)
+      {
+         const auto& t = m_shards[i].m_tree;
+         if (t.begin() != t.end())
+            heads.insert(cursor_t{t.begin(), t.end()});
+      }
+
+      while (!heads.empty())
+      {
+         auto c = heads.max();
+         heads.del_max();
+         f(c.m_it->first, c.m_it->second);
+         if (++c.m_it != c.m_end)
+            heads.insert(c);
+      }
+   }
+
+private:
+   static constexpr std::size_t cache_line = 64;
+
+   struct shard_t
+   {
+      mutable std::mutex m_mutex;
+      TreeType m_tree;
+      // keeps neighbour shards off each other's cache lines, whatever the
+      // alignment of the array
+      char m_pad[cache_line];
+   };
+
+   using const_iterator = typename TreeType::const_iterator;
+
+   struct cursor_t
+   {
+      const_iterator m_it;
+      const_iterator m_end;
+   };
+
+   // Orders the heap so that its max is the smallest key.
+   struct cursor_less_t
+   {
+      typename TreeType::less_t m_less;
+
+      bool operator()(const cursor_t& a, const cursor_t& b) const
+      {
+         return m_less(b.m_it->first, a.m_it->first);
+      }
+   };
+
+   std::unique_ptr<shard_t[]> m_shards;
+   std::size_t m_nb_shards;
+   unsigned m_bits = 0;
+   HashType m_hash;
+
+   static std::size_t default_nb_shards()
+   {
+      const std::size_t n = std::thread::hardware_concurrency();
+      return n ? 4 * n : 16;
+   }
+
+   // Fibonacci hashing: the top bits of the product mix all the bits of the
+   // hash, which std::hash of integers leaves as they are.
+   shard_t& shard_of(const key_t& key) const
+   {
+      if (m_bits == 0)
+         return m_shards[0];
+      const auto h = static_cast<std::uint64_t>(m_hash(key)) *
+         UINT64_C(0x9e3779b97f4a7c15);
+      return m_shards[static_cast<std::size_t>(h >> (64 - m_bits))];
+   }
+};
+
+}
+
+#endif
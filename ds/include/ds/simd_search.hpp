@@ -0,0 +1,266 @@
+#ifndef DATASTRUCTURES_SIMD_SEARCH_HPP
+#define DATASTRUCTURES_SIMD_SEARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+   (defined(__x86_64__) || defined(__i386__))
+#define DS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ds
+{
+
+namespace detail
+{
+
+enum class simd_level_t { scalar, sse, avx2 };
+
+#ifdef DS_SIMD_X86
+
+inline simd_level_t detect_simd_level()
+{
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return simd_level_t::avx2;
+   if (__builtin_cpu_supports("sse4.2"))
+      return simd_level_t::sse;
+   return simd_level_t::scalar;
+}
+
+// Widest instruction set the running CPU supports.
+inline simd_level_t simd_level()
+{
+   static const simd_level_t level = detect_simd_level();
+   return level;
+}
+
+#else
+
+inline simd_level_t simd_level()
+{
+   return simd_level_t::scalar;
+}
+
+#endif
+
+// The kernels below count, among n sorted integer keys, those less than key
+// or, with OrEqual, those not greater than key: that is the lower_bound or
+// upper_bound index. Sorted keys let the whole node be compared at once
+// instead of branching on every probe of a binary search.
+
+template <bool OrEqual, typename KeyType>
+std::size_t scalar_count(const KeyType* keys, std::size_t n, KeyType key)
+{
+   std::size_t c = 0;
+   for (std::size_t i = 0; i < n; ++i)
+      c += OrEqual ? !(key < keys[i]) : keys[i] < key;
+   return c;
+}
+
+#ifdef DS_SIMD_X86
+
+// Unsigned keys are compared as signed ones once their top bit is flipped.
+template <typename KeyType>
+constexpr std::int64_t simd_bias()
+{
+   return std::is_signed<KeyType>::value ? 0 :
+      (sizeof(KeyType) == 4 ? INT32_MIN : INT64_MIN);
+}
+
+template <bool OrEqual, typename KeyType>
+__attribute__((target("avx2")))
+std::size_t avx2_count(const KeyType* keys, std::size_t n, KeyType key,
+                       std::integral_constant<std::size_t, 4>)
+{
+   const auto bias =
+      _mm256_set1_epi32(static_cast<std::int32_t>(simd_bias<KeyType>()));
+   const auto k = _mm256_xor_si256(
+      _mm256_set1_epi32(static_cast<std::int32_t>(key)), bias);
+   auto acc = _mm256_setzero_si256();
+   std::size_t i = 0;
+   for (; i + 8 <= n; i += 8)
+   {
+      const auto p = reinterpret_cast<const __m256i*>(keys + i);
+      const auto v = _mm256_xor_si256(_mm256_loadu_si256(p), bias);
+      acc = _mm256_sub_epi32(acc, OrEqual ? _mm256_cmpgt_epi32(v, k) :
+                                            _mm256_cmpgt_epi32(k, v));
+   }
+
+   alignas(32) std::int32_t lanes[8];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+   std::size_t c = 0;
+   for (auto l : lanes)
+      c += l;
+   c = OrEqual ? i - c : c;
+   return c + scalar_count<OrEqual>(keys + i, n - i, key);
+}
+
+template <bool OrEqual, typename KeyType>
+__attribute__((target("avx2")))
+std::size_t avx2_count(const KeyType* keys, std::size_t n, KeyType key,
+                       std::integral_constant<std::size_t, 8>)
+{
+   const auto bias = _mm256_set1_epi64x(simd_bias<KeyType>());
+   const auto k = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+   auto acc = _mm256_setzero_si256();
+   std::size_t i = 0;
+   for (; i + 4 <= n; i += 4)
+   {
+      const auto p = reinterpret_cast<const __m256i*>(keys + i);
+      const auto v = _mm256_xor_si256(_mm256_loadu_si256(p), bias);
+      acc = _mm256_sub_epi64(acc, OrEqual ? _mm256_cmpgt_epi64(v, k) :
+                                            _mm256_cmpgt_epi64(k, v));
+   }
+
+   alignas(32) std::int64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+   std::size_t c = 0;
+   for (auto l : lanes)
+      c += l;
+   c = OrEqual ? i - c : c;
+   return c + scalar_count<OrEqual>(keys + i, n - i, key);
+}
+
+template <bool OrEqual, typename KeyType>
+__attribute__((target("sse4.2")))
+std::size_t sse_count(const KeyType* keys, std::size_t n, KeyType key,
+                      std::integral_constant<std::size_t, 4>)
+{
+   const auto bias =
+      _mm_set1_epi32(static_cast<std::int32_t>(simd_bias<KeyType>()));
+   const auto k = _mm_xor_si128(
+      _mm_set1_epi32(static_cast<std::int32_t>(key)), bias);
+   auto acc = _mm_setzero_si128();
+   std::size_t i = 0;
+   for (; i + 4 <= n; i += 4)
+   {
+      const auto p = reinterpret_cast<const __m128i*>(keys + i);
+      const auto v = _mm_xor_si128(_mm_loadu_si128(p), bias);
+      acc = _mm_sub_epi32(acc, OrEqual ? _mm_cmpgt_epi32(v, k) :
+                                         _mm_cmpgt_epi32(k, v));
+   }
+
+   alignas(16) std::int32_t lanes[4];
+   _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+   std::size_t c = 0;
+   for (auto l : lanes)
+      c += l;
+   c = OrEqual ? i - c : c;
+   return c + scalar_count<OrEqual>(keys + i, n - i, key);
+}
+
+template <bool OrEqual, typename KeyType>
+__attribute__((target("sse4.2")))
+std::size_t sse_count(const KeyType* keys, std::size_t n, KeyType key,
+                      std::integral_constant<std::size_t, 8>)
+{
+   const auto bias = _mm_set1_epi64x(simd_bias<KeyType>());
+   const auto k = _mm_xor_si128(
+      _mm_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+   auto acc = _mm_setzero_si128();
+   std::size_t i = 0;
+   for (; i + 2 <= n; i += 2)
+   {
+      const auto p = reinterpret_cast<const __m128i*>(keys + i);
+      const auto v = _mm_xor_si128(_mm_loadu_si128(p), bias);
+      acc = _mm_sub_epi64(acc, OrEqual ? _mm_cmpgt_epi64(v, k) :
+                                         _mm_cmpgt_epi64(k, v));
+   }
+
+   alignas(16) std::int64_t lanes[2];
+   _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+   std::size_t c = 0;
+   for (auto l : lanes)
+      c += l;
+   c = OrEqual ? i - c : c;
+   return c + scalar_count<OrEqual>(keys + i, n - i, key);
+}
+
+#endif
+
+template <typename KeyType>
+struct is_simd_key_t:
+   std::integral_constant<bool,
+                          std::is_integral<KeyType>::value &&
+                          !std::is_same<KeyType, bool>::value &&
+                          (sizeof(KeyType) == 4 || sizeof(KeyType) == 8)>
+{};
+
+// Counting kernels of KeyType, the best one for the running CPU being picked
+// on first use. Only enabled for 32 and 64-bit integer keys on x86.
+template <typename KeyType, typename = void>
+struct simd_search_t
+{
+   static constexpr bool enabled = false;
+};
+
+#ifdef DS_SIMD_X86
+
+template <typename KeyType>
+struct simd_search_t<KeyType,
+                     typename std::enable_if<
+                        is_simd_key_t<KeyType>::value>::type>
+{
+   static constexpr bool enabled = true;
+
+   using kernel_t = std::size_t (*)(const KeyType*, std::size_t, KeyType);
+
+   // Kernel for the given level, which must not exceed simd_level().
+   static kernel_t kernel(simd_level_t level, bool or_equal)
+   {
+      switch (level)
+      {
+      case simd_level_t::avx2:
+         return or_equal ? &avx2<true> : &avx2<false>;
+      case simd_level_t::sse:
+         return or_equal ? &sse<true> : &sse<false>;
+      default:
+         return or_equal ? &scalar_count<true, KeyType> :
+                           &scalar_count<false, KeyType>;
+      }
+   }
+
+   static std::size_t count_less(const KeyType* keys, std::size_t n,
+                                 KeyType key)
+   {
+      static const kernel_t k = kernel(simd_level(), false);
+      return k(keys, n, key);
+   }
+
+   static std::size_t count_less_equal(const KeyType* keys, std::size_t n,
+                                       KeyType key)
+   {
+      static const kernel_t k = kernel(simd_level(), true);
+      return k(keys, n, key);
+   }
+
+private:
+   using width_t = std::integral_constant<std::size_t, sizeof(KeyType)>;
+
+   template <bool OrEqual>
+   __attribute__((target("avx2")))
+   static std::size_t avx2(const KeyType* keys, std::size_t n, KeyType key)
+   {
+      return avx2_count<OrEqual>(keys, n, key, width_t());
+   }
+
+   template <bool OrEqual>
+   __attribute__((target("sse4.2")))
+   static std::size_t sse(const KeyType* keys, std::size_t n, KeyType key)
+   {
+      return sse_count<OrEqual>(keys, n, key, width_t());
+   }
+};
+
+#endif
+
+}
+
+}
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef DATASTRUCTURES_SKIP_LIST_HPP
+#define DATASTRUCTURES_SKIP_LIST_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "ds/epoch.hpp"
+
+namespace ds
+{
+
+namespace detail
+{
+
+template <typename ValueType>
+struct sl_value_t: retired_t
+{
+   explicit sl_value_t(const ValueType& value):
+      retired_t(&free),
+      m_value(value)
+   {}
+
+   static void free(retired_t* r)
+   {
+      delete static_cast<sl_value_t*>(r);
+   }
+
+   ValueType m_value;
+};
+
+// A node and its tower of links, allocated in one block. The low bit of a
+// link marks the node as being removed at that level.
+template <typename KeyType, typename ValueType>
+struct sl_node_t: retired_t
+{
+   using link_t = std::atomic<std::uintptr_t>;
+   using box_t = sl_value_t<ValueType>;
+
+   static sl_node_t* create(const KeyType& key, box_t* value,
+                            unsigned height)
+   {
+      const auto mem =
+         ::operator new(sizeof(sl_node_t) + height * sizeof(link_t));
+      sl_node_t* node;
+      try
+      {
+         node = new (mem) sl_node_t(key, value, height);
+      }
+      catch (...)
+      {
+         ::operator delete(mem);
+         throw;
+      }
+      for (unsigned l = 0; l < height; ++l)
+         new (node->links() + l) link_t(0);
+      return node;
+   }
+
+   static void free(retired_t* r)
+   {
+      const auto node = static_cast<sl_node_t*>(r);
+      delete node->m_value.load();
+      node->~sl_node_t();
+      ::operator delete(node);
+   }
+
+   link_t* links()
+   {
+      return reinterpret_cast<link_t*>(this + 1);
+   }
+
+   KeyType m_key;
+   std::atomic<box_t*> m_value;
+   unsigned m_height;
+   // the inserter and the remover, the last one done retires the node
+   std::atomic<unsigned> m_refs{2};
+
+private:
+   sl_node_t(const KeyType& key, box_t* value, unsigned height):
+      retired_t(&free),
+      m_key(key),
+      m_value(value),
+      m_height(height)
+   {}
+};
+
+}
+
+// Ordered map for concurrent readers and writers, none of which lock.
+// Nodes are linked at level 0 by compare-and-swap, then up their tower;
+// removal marks the links of a node, top to bottom, and whoever walks past
+// it unlinks it. Unlinked nodes and replaced values are freed once the
+// threads that may still see them are done, as in rcu_map_t.
+//
+// Lookups copy the value out, as no reference can outlive the read. The
+// comparison must not throw.
+template <typename KeyType, typename ValueType,
+          typename LessType = std::less<KeyType>>
+class skip_list_t
+{
+   using node_t = detail::sl_node_t<KeyType, ValueType>;
+   using box_t = typename node_t::box_t;
+   using link_t = typename node_t::link_t;
+   using guard_t = detail::epoch_domain_t::guard_t;
+
+public:
+   using key_t = KeyType;
+   using value_t = ValueType;
+   using less_t = LessType;
+
+   static constexpr unsigned max_height = 32;
+
+   skip_list_t(const LessType& less = LessType()):
+      m_less(less)
+   {}
+
+   // No thread may be left using the list.
+   ~skip_list_t()
+   {
+      auto node = node_of(m_head[0].load());
+      while (node)
+      {
+         const auto next = node_of(node->links()[0].load());
+         node_t::free(node);
+         node = next;
+      }
+   }
+
+   skip_list_t(const skip_list_t&) = delete;
+   skip_list_t& operator=(const skip_list_t&) = delete;
+
+   void put(const key_t& key, const value_t& value)
+   {
+      guard_t guard;
+      std::unique_ptr<box_t> box(new box_t(value));
+      node_t* node = nullptr;
+      link_t* preds[max_height];
+      node_t* succs[max_height];
+      for (;;)
+      {
+         find(key, preds, succs, false);
+         const auto found = succs[0];
+         if (found && !m_less(key, found->m_key))
+         {
+            if (node)
+            {
+               box.reset(node->m_value.exchange(nullptr));
+               node_t::free(node);
+               node = nullptr;
+            }
+            m_limbo.retire(found->m_value.exchange(box.release()));
+            // a removal that came first would lose the value
+            if (!is_marked(found->links()[0].load()))
+               return;
+            box.reset(new box_t(value));
+            continue;
+         }
+
+         if (!node)
+         {
+            node = node_t::create(key, box.get(), random_height());
+            box.release();
+         }
+         for (unsigned l = 0; l < node->m_height; ++l)
+            node->links()[l].store(link_of(succs[l]));
+
+         m_size.fetch_add(1);
+         auto expected = link_of(succs[0]);
+         if (preds[0][0].compare_exchange_strong(expected, link_of(node)))
+            break;
+         m_size.fetch_sub(1);
+      }
+
+      link_tower(key, node, preds, succs);
+      // removed while going up, some levels may still link it
+      if (is_marked(node->links()[0].load()))
+         find(key, preds, succs, true);
+      release(node);
+   }
+
+   // Returns true when the key was found and removed.
+   bool remove(const key_t& key)
+   {
+      guard_t guard;
+      link_t* preds[max_height];
+      node_t* succs[max_height];
+      find(key, preds, succs, false);
+      const auto node = succs[0];
+      if (!node || m_less(key, node->m_key))
+         return false;
+
+      for (auto l = node->m_height; l-- > 1;)
+      {
+         auto next = node->links()[l].load();
+         while (!is_marked(next) &&
+                !node->links()[l].compare_exchange_weak(next, next | 1))
+         {}
+      }
+
+      // marking level 0 removes the key, only one remover gets to
+      auto next = node->links()[0].load();
+      do
+      {
+         if (is_marked(next))
+            return false;
+      }
+      while (!node->links()[0].compare_exchange_weak(next, next | 1));
+
+      m_size.fetch_sub(1);
+      find(key, preds, succs, true);
+      release(node);
+      return true;
+   }
+
+   // Copies the value of key, if present, to value.
+   bool get(const key_t& key, value_t& value) const
+   {
+      guard_t guard;
+      const auto node = lookup(key);
+      if (!node)
+         return false;
+      value = node->m_value.load()->m_value;
+      return true;
+   }
+
+   bool contains(const key_t& key) const
+   {
+      guard_t guard;
+      return lookup(key) != nullptr;
+   }
+
+   std::size_t size() const
+   {
+      return m_size.load(std::memory_order_relaxed);
+   }
+
+   // Calls f(key, value) on the elements in key order. Concurrent updates
+   // may or may not be seen.
+   template <typename FunType>
+   void for_each(FunType f) const
+   {
+      guard_t guard;
+      auto node = node_of(m_head[0].load());
+      while (node)
+      {
+         const auto next = node->links()[0].load();
+         if (!is_marked(next))
+            f(node->m_key, node->m_value.load()->m_value);
+         node = node_of(next);
+      }
+   }
+
+private:
+   link_t m_head[max_height] = {};
+   std::atomic<std::size_t> m_size{0};
+   LessType m_less;
+   detail::limbo_t m_limbo;
+
+   static node_t* node_of(std::uintptr_t link)
+   {
+      return reinterpret_cast<node_t*>(link & ~std::uintptr_t(1));
+   }
+
+   static std::uintptr_t link_of(const node_t* node)
+   {
+      return reinterpret_cast<std::uintptr_t>(node);
+   }
+
+   static bool is_marked(std::uintptr_t link)
+   {
+      return link & 1;
+   }
+
+   // Geometric, one level in two goes up.
+   static unsigned random_height()
+   {
+      static thread_local std::uint32_t state = static_cast<std::uint32_t>(
+         std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+
+      unsigned height = 1;
+      for (auto r = state; (r & 1) && height < max_height; r >>= 1)
+         ++height;
+      return height;
+   }
+
+   // Walks level l from the link pred to the first node curr for which
+   // keep fails, unlinking the removed nodes met on the way. Returns false
+   // when another thread changed pred first.
+   template <typename KeepType>
+   static bool walk(link_t*& pred, node_t*& curr, unsigned l, KeepType keep)
+   {
+      curr = node_of(pred[l].load());
+      while (curr)
+      {
+         const auto succ = curr->links()[l].load();
+         if (is_marked(succ))
+         {
+            auto expected = link_of(curr);
+            if (!pred[l].compare_exchange_strong(expected,
+                                               succ & ~std::uintptr_t(1)))
+               return false;
+            curr = node_of(succ);
+         }
+         else if (keep(curr))
+         {
+            pred = curr->links();
+            curr = node_of(succ);
+         }
+         else
+         {
+            break;
+         }
+      }
+      return true;
+   }
+
+   // Fills preds and succs with, at every level, the last link before key
+   // and the first live node not before it. With unlink_key, the removed
+   // nodes holding key are unlinked too, even past a live one.
+   void find(const key_t& key, link_t** preds, node_t** succs,
+             bool unlink_key)
+   {
+      while (!try_find(key, preds, succs, unlink_key))
+      {}
+   }
+
+   bool try_find(const key_t& key, link_t** preds, node_t** succs,
+                 bool unlink_key)
+   {
+      const auto before = [&](const node_t* n) {
+         return m_less(n->m_key, key);
+      };
+      const auto holds = [&](const node_t* n) {
+         return !m_less(key, n->m_key);
+      };
+
+      link_t* pred = m_head;
+      for (auto l = max_height; l-- > 0;)
+      {
+         node_t* curr;
+         if (!walk(pred, curr, l, before))
+            return false;
+         preds[l] = pred;
+         succs[l] = curr;
+
+         auto p = pred;
+         if (unlink_key && curr && !walk(p, curr, l, holds))
+            return false;
+      }
+      return true;
+   }
+
+   // Same as find, without helping: removed nodes are stepped over.
+   node_t* lookup(const key_t& key) const
+   {
+      const link_t* pred = m_head;
+      node_t* curr = nullptr;
+      for (auto l = max_height; l-- > 0;)
+      {
+         curr = node_of(pred[l].load());
+         while (curr)
+         {
+            const auto succ = curr->links()[l].load();
+            if (is_marked(succ))
+            {
+               curr = node_of(succ);
+            }
+            else if (m_less(curr->m_key, key))
+            {
+               pred = curr->links();
+               curr = node_of(succ);
+            }
+            else
+            {
+               break;
+            }
+         }
+      }
+      return curr && !m_less(key, curr->m_key) ? curr : nullptr;
+   }
+
+   // Links the levels above 0 of a node that is linked at level 0, giving
+   // up once the node is being removed.
+   void link_tower(const key_t& key, node_t* node, link_t** preds,
+                   node_t** succs)
+   {
+      for (unsigned l = 1; l < node->m_height; ++l)
+      {
+         for (;;)
+         {
+            auto next = node->links()[l].load();
+            const auto succ = link_of(succs[l]);
+            // fails only when marked, as nobody else links from it yet
+            if (is_marked(next) ||
+                (next != succ &&
+                 !node->links()[l].compare_exchange_strong(next, succ)))
+               return;
+
+            auto expected = succ;
+            if (preds[l][l].compare_exchange_strong(expected,
+                                                    link_of(node)))
+               break;
+
+            find(key, preds, succs, false);
+            if (succs[0] != node)
+               return;
+         }
+      }
+   }
+
+   void release(node_t* node)
+   {
+      if (node->m_refs.fetch_sub(1) == 1)
+         m_limbo.retire(node);
+   }
+};
+
+}
+
+#endif
@@ -5,6 +5,8 @@
 #include <cassert>
 #include <iterator>
 #include <functional>
+#include <utility>
+#include <vector>
 
 namespace ds
 {
@@ -132,7 +134,8 @@ template <typename IteratorType, typename LessType>
 void merge(IteratorType begin, IteratorType mid, IteratorType end,
            LessType less)
 {
-   std::vector<typename IteratorType::value_type> aux(begin, end);
+   std::vector<typename std::iterator_traits<IteratorType>::value_type> aux(
+      std::make_move_iterator(begin), std::make_move_iterator(end));
    auto m = std::next(aux.begin(), std::distance(begin, mid));
    auto i = aux.begin(), j = m;
 
@@ -146,7 +149,7 @@ void merge(IteratorType begin, IteratorType mid, IteratorType end,
       else
          p = less(*j, *i) ? j++ : i++;
 
-      *o = *p;
+      *o = std::move(*p);
    }
 }
 
@@ -228,7 +231,7 @@ void quick_sort(IteratorType begin, IteratorType end)
 namespace detail
 {
 
-size_t child_index(size_t i)
+inline size_t child_index(size_t i)
 {
   return 2 * (i + 1) - 1;
 }
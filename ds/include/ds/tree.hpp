@@ -1,19 +1,41 @@
 #ifndef DATASTRUCTURES_TREE_HPP
 #define DATASTRUCTURES_TREE_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <iterator>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ds/node_alloc.hpp"
+#include "ds/sort.hpp"
 
 namespace ds
 {
 
+// Set operations of tree_t::combine.
+enum class set_op_t { unite, intersect, subtract };
+
 namespace detail
 {
 
+template <typename NodeType>
+struct node_deleter_t
+{
+   void operator()(NodeType* node) const
+   {
+      NodeType::alloc_t::template arena_t<NodeType>::destroy(node);
+   }
+};
+
 template <typename NodeType>
 struct node_trait_t
 {
-   using ptr_t = std::unique_ptr<NodeType>;
+   using ptr_t = std::unique_ptr<NodeType, node_deleter_t<NodeType>>;
    using key_t = decltype(NodeType::m_key);
    using value_t = decltype(NodeType::m_value);
 };
@@ -21,26 +43,316 @@ struct node_trait_t
 template<typename KeyType, typename ValueType, typename NodeType>
 struct node_base_t
 {
-   node_base_t(NodeType* parent, const KeyType &key, const ValueType& value):
-      m_key(key),
-      m_value(value),
+   template <typename KeyArgType, typename... ValueArgTypes>
+   node_base_t(NodeType* parent, KeyArgType&& key, ValueArgTypes&&... args):
+      m_key(std::forward<KeyArgType>(key)),
+      m_value(std::forward<ValueArgTypes>(args)...),
       m_parent(parent)
    {}
 
+   NodeType* parent() const
+   {
+      return m_parent;
+   }
+
+   void set_parent(NodeType* parent)
+   {
+      m_parent = parent;
+   }
+
    KeyType m_key;
    ValueType m_value;
+   std::size_t m_count = 1; // number of nodes in the subtree
    NodeType* m_parent;
-   typename node_trait_t<NodeType>::ptr_t m_left;
-   typename node_trait_t<NodeType>::ptr_t m_right;
+   std::unique_ptr<NodeType, node_deleter_t<NodeType>> m_left;
+   std::unique_ptr<NodeType, node_deleter_t<NodeType>> m_right;
+};
+
+// Denser variant of node_base_t: the key sits right after the child pointers
+// and the parent pointer lends its low bit to a one-bit tag (the node color
+// for red-black trees) so that no padded flag field is needed.
+template<typename KeyType, typename ValueType, typename NodeType>
+struct compact_node_base_t
+{
+   template <typename KeyArgType, typename... ValueArgTypes>
+   compact_node_base_t(NodeType* parent, bool tag, KeyArgType&& key,
+                       ValueArgTypes&&... args):
+      m_key(std::forward<KeyArgType>(key)),
+      m_value(std::forward<ValueArgTypes>(args)...),
+      m_link(reinterpret_cast<std::uintptr_t>(parent) | (tag ? 1 : 0))
+   {}
+
+   NodeType* parent() const
+   {
+      return reinterpret_cast<NodeType*>(m_link & ~std::uintptr_t(1));
+   }
+
+   void set_parent(NodeType* parent)
+   {
+      m_link = reinterpret_cast<std::uintptr_t>(parent) | (m_link & 1);
+   }
+
+   bool tag() const
+   {
+      return (m_link & 1) != 0;
+   }
+
+   void set_tag(bool tag)
+   {
+      m_link = (m_link & ~std::uintptr_t(1)) | (tag ? 1 : 0);
+   }
+
+   std::unique_ptr<NodeType, node_deleter_t<NodeType>> m_left;
+   std::unique_ptr<NodeType, node_deleter_t<NodeType>> m_right;
+   KeyType m_key;
+   ValueType m_value;
+   std::size_t m_count = 1; // number of nodes in the subtree
+
+private:
+   std::uintptr_t m_link; // parent pointer | tag
+};
+
+// Structural counters for benchmarks, compiled in with DS_TREE_STATS. They
+// are atomic since combine() rebalances subtrees on several threads.
+struct tree_stats_t
+{
+   static std::atomic<std::size_t>& rotations()
+   {
+      static std::atomic<std::size_t> n(0);
+      return n;
+   }
+};
+
+template <typename>
+struct void_t
+{
+   using type = void;
+};
+
+template <typename LessType, typename = void>
+struct is_transparent_t: std::false_type
+{};
+
+template <typename LessType>
+struct is_transparent_t<
+   LessType, typename void_t<typename LessType::is_transparent>::type>:
+   std::true_type
+{};
+
+// Enables the heterogeneous lookup overloads of tree_t, which compare
+// KeyArgType values directly with the stored keys when the comparator
+// declares is_transparent (as std::map does).
+template <typename LessType, typename KeyArgType>
+using enable_if_transparent_t = typename std::enable_if<
+   is_transparent_t<LessType>::value, KeyArgType>::type;
+
+template <typename NodePtrType>
+std::size_t node_count(const NodePtrType& node)
+{
+   return node ? node->m_count : 0;
+}
+
+template <typename NodePtrType>
+void update_count(NodePtrType& node)
+{
+   node->m_count = 1 + node_count(node->m_left) + node_count(node->m_right);
+}
+
+template <typename NodeType>
+NodeType* tree_min(NodeType* node)
+{
+   while (node && node->m_left)
+      node = node->m_left.get();
+   return node;
+}
+
+template <typename NodeType>
+NodeType* tree_max(NodeType* node)
+{
+   while (node && node->m_right)
+      node = node->m_right.get();
+   return node;
+}
+
+// In-order successor, nullptr past the largest node.
+template <typename NodeType>
+NodeType* tree_next(NodeType* node)
+{
+   if (node->m_right)
+      return tree_min(node->m_right.get());
+
+   auto p = node->parent();
+   while (p && node == p->m_right.get())
+   {
+      node = p;
+      p = p->parent();
+   }
+   return p;
+}
+
+// In-order predecessor, nullptr before the smallest node.
+template <typename NodeType>
+NodeType* tree_prev(NodeType* node)
+{
+   if (node->m_left)
+      return tree_max(node->m_left.get());
+
+   auto p = node->parent();
+   while (p && node == p->m_left.get())
+   {
+      node = p;
+      p = p->parent();
+   }
+   return p;
+}
+
+template <typename ReferenceType>
+struct arrow_proxy_t
+{
+   ReferenceType m_ref;
+
+   ReferenceType* operator->()
+   {
+      return &m_ref;
+   }
+};
+
+// Bidirectional in-order iterator. Dereferencing yields a pair of references
+// to the key and the value of the node. The end iterator keeps a pointer to
+// the root so that it can be decremented.
+template <typename NodeType, bool IsConst>
+class tree_iterator_t
+{
+   using node_ptr_t = typename node_trait_t<NodeType>::ptr_t;
+   using key_t = typename node_trait_t<NodeType>::key_t;
+   using mapped_t = typename node_trait_t<NodeType>::value_t;
+
+public:
+   using iterator_category = std::bidirectional_iterator_tag;
+   using value_type = std::pair<const key_t, mapped_t>;
+   using difference_type = std::ptrdiff_t;
+   using reference =
+      std::pair<const key_t&,
+                typename std::conditional<IsConst, const mapped_t&,
+                                          mapped_t&>::type>;
+   using pointer = arrow_proxy_t<reference>;
+
+   tree_iterator_t() = default;
+
+   tree_iterator_t(NodeType* node, const node_ptr_t* root):
+      m_node(node),
+      m_root(root)
+   {}
+
+   template <bool WasConst,
+             typename = typename std::enable_if<IsConst && !WasConst>::type>
+   tree_iterator_t(const tree_iterator_t<NodeType, WasConst>& other):
+      m_node(other.node()),
+      m_root(other.root())
+   {}
+
+   reference operator*() const
+   {
+      return reference(m_node->m_key, m_node->m_value);
+   }
+
+   pointer operator->() const
+   {
+      return pointer{**this};
+   }
+
+   tree_iterator_t& operator++()
+   {
+      m_node = tree_next(m_node);
+      return *this;
+   }
+
+   tree_iterator_t operator++(int)
+   {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+   }
+
+   tree_iterator_t& operator--()
+   {
+      m_node = m_node ? tree_prev(m_node) : tree_max(m_root->get());
+      return *this;
+   }
+
+   tree_iterator_t operator--(int)
+   {
+      auto tmp = *this;
+      --*this;
+      return tmp;
+   }
+
+   friend bool operator==(const tree_iterator_t& lhs,
+                          const tree_iterator_t& rhs)
+   {
+      return lhs.m_node == rhs.m_node;
+   }
+
+   friend bool operator!=(const tree_iterator_t& lhs,
+                          const tree_iterator_t& rhs)
+   {
+      return lhs.m_node != rhs.m_node;
+   }
+
+   NodeType* node() const { return m_node; }
+
+   const node_ptr_t* root() const { return m_root; }
+
+private:
+   NodeType* m_node = nullptr;
+   const node_ptr_t* m_root = nullptr;
+};
+
+template <typename IteratorType>
+class range_t
+{
+public:
+   range_t(IteratorType begin, IteratorType end):
+      m_begin(begin),
+      m_end(end)
+   {}
+
+   IteratorType begin() const { return m_begin; }
+
+   IteratorType end() const { return m_end; }
+
+   bool empty() const { return m_begin == m_end; }
+
+private:
+   IteratorType m_begin;
+   IteratorType m_end;
+};
+
+// Gives the code that walks tree_t nodes itself (see coro_lookup.hpp) their
+// root, which is not part of the tree interface.
+struct tree_access_t
+{
+   template <typename TreeType>
+   static const typename TreeType::node_ptr_t& root(const TreeType& tree)
+   {
+      return tree.m_root;
+   }
 };
 
 template<typename NodeType, typename LessType, typename ImplType>
 class tree_t
 {
+   friend struct tree_access_t;
+
 public:
    using node_ptr_t = typename node_trait_t<NodeType>::ptr_t;
    using key_t = typename node_trait_t<NodeType>::key_t;
    using value_t = typename node_trait_t<NodeType>::value_t;
+   using arena_t =
+      typename NodeType::alloc_t::template arena_t<NodeType>;
+   using iterator = tree_iterator_t<NodeType, false>;
+   using const_iterator = tree_iterator_t<NodeType, true>;
+   using less_t = LessType;
 
    tree_t(const LessType& less):
       m_less(less),
@@ -51,53 +363,855 @@ public:
       m_impl(m_less)
    {}
 
-   void put(const key_t& key, const value_t& value)
+   // Builds the tree out of a range of (key, value) pairs sorted by strictly
+   // increasing keys, in linear time.
+   template <typename IteratorType>
+   tree_t(IteratorType begin, IteratorType end,
+          const LessType& less = LessType()):
+      m_less(less),
+      m_impl(m_less)
+   {
+      assign_sorted(begin, end);
+   }
+
+   ~tree_t()
+   {
+      clear();
+   }
+
+   tree_t(tree_t&& other):
+      m_arena(std::move(other.m_arena)),
+      m_root(std::move(other.m_root)),
+      m_max(other.m_max),
+      m_size(other.m_size),
+      m_less(std::move(other.m_less)),
+      m_impl(m_less)
+   {
+      other.m_max = nullptr;
+      other.m_size = 0;
+   }
+
+   tree_t& operator=(tree_t&& other)
+   {
+      if (this == &other)
+         return *this;
+
+      clear();
+      m_arena = std::move(other.m_arena);
+      m_root = std::move(other.m_root);
+      m_max = other.m_max;
+      other.m_max = nullptr;
+      m_size = other.m_size;
+      other.m_size = 0;
+      m_less = std::move(other.m_less);
+      m_impl = ImplType(m_less);
+      return *this;
+   }
+
+   template <typename ValueArgType>
+   void put(const key_t& key, ValueArgType&& value)
+   {
+      insert_or_assign(key, std::forward<ValueArgType>(value));
+   }
+
+   template <typename ValueArgType>
+   void put(key_t&& key, ValueArgType&& value)
+   {
+      insert_or_assign(std::move(key), std::forward<ValueArgType>(value));
+   }
+
+   // Same as put, searching for key from the element hint instead of the
+   // root: the comparisons then grow with the distance between the two in
+   // the tree, so a stream of nearly sorted keys costs about O(1) of them
+   // per key when each put is given the element returned by the previous
+   // one. The end iterator stands for the largest element. Returns the
+   // element of key.
+   template <typename ValueArgType>
+   iterator put_hint(const_iterator hint, const key_t& key,
+                     ValueArgType&& value)
+   {
+      return _put_hint(hint, key, std::forward<ValueArgType>(value));
+   }
+
+   template <typename ValueArgType>
+   iterator put_hint(const_iterator hint, key_t&& key, ValueArgType&& value)
+   {
+      return _put_hint(hint, std::move(key),
+                       std::forward<ValueArgType>(value));
+   }
+
+   // Inserts a value constructed in place from args unless the key is
+   // already present, in which case nothing is constructed nor modified.
+   template <typename... ArgTypes>
+   std::pair<iterator, bool> try_emplace(const key_t& key, ArgTypes&&... args)
+   {
+      return _emplace(key, std::forward<ArgTypes>(args)...);
+   }
+
+   template <typename... ArgTypes>
+   std::pair<iterator, bool> try_emplace(key_t&& key, ArgTypes&&... args)
+   {
+      return _emplace(std::move(key), std::forward<ArgTypes>(args)...);
+   }
+
+   // Same as try_emplace, with a key constructed from any argument.
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<iterator, bool> emplace(KeyArgType&& key, ArgTypes&&... args)
    {
-      m_impl.put(m_root, key, value);
+      return _emplace(key_t(std::forward<KeyArgType>(key)),
+                      std::forward<ArgTypes>(args)...);
+   }
+
+   // Inserts the value, or assigns it to the element already present.
+   template <typename ValueArgType>
+   std::pair<iterator, bool> insert_or_assign(const key_t& key,
+                                              ValueArgType&& value)
+   {
+      return _insert_or_assign(key, std::forward<ValueArgType>(value));
+   }
+
+   template <typename ValueArgType>
+   std::pair<iterator, bool> insert_or_assign(key_t&& key,
+                                              ValueArgType&& value)
+   {
+      return _insert_or_assign(std::move(key),
+                               std::forward<ValueArgType>(value));
+   }
+
+   // Replaces the content of the tree with a range of (key, value) pairs
+   // sorted by strictly increasing keys, in linear time.
+   template <typename IteratorType>
+   void assign_sorted(IteratorType begin, IteratorType end)
+   {
+      clear();
+      const auto n = static_cast<std::size_t>(std::distance(begin, end));
+      m_root = ImplType::build(m_arena, begin, n);
+      m_max = tree_max(m_root.get());
+      m_size = n;
+   }
+
+   // Puts a range of (key, value) pairs, of which the last one wins for a
+   // key given several times. The batch is sorted then merged in key order:
+   // each pair is searched from the one before, as with put_hint, and a
+   // batch as large as the tree rebuilds it in linear time instead.
+   template <typename IteratorType>
+   void put_batch(IteratorType begin, IteratorType end)
+   {
+      std::vector<std::pair<key_t, value_t>> batch(begin, end);
+      merge_sort(batch.begin(), batch.end(),
+                 [this](const std::pair<key_t, value_t>& a,
+                        const std::pair<key_t, value_t>& b)
+                 {
+                    return m_less(a.first, b.first);
+                 });
+
+      // the sort is stable: the last pair of a run of equal keys wins
+      auto out = batch.begin();
+      for (auto it = batch.begin(); it != batch.end(); ++it)
+      {
+         const auto next = std::next(it);
+         if (next != batch.end() && !m_less(it->first, next->first))
+            continue;
+         if (out != it)
+            *out = std::move(*it);
+         ++out;
+      }
+      batch.erase(out, batch.end());
+
+      if (batch.empty())
+         return;
+      // past the size of the tree, relinking it beats searching it
+      if (batch.size() >= m_size)
+      {
+         rebuild_with(batch);
+         return;
+      }
+
+      const_iterator hint = this->end();
+      for (auto& kv : batch)
+         hint = _put_hint(hint, std::move(kv.first), std::move(kv.second));
+   }
+
+   // Appends a new element (key, value) then the elements of right, which
+   // is left empty, in O(log n). The keys of the tree must be less than key
+   // and those of right greater. Needs an implementation that joins trees
+   // (rb_tree_t) and an allocation policy whose nodes can change trees.
+   template <typename ValueArgType>
+   void join(const key_t& key, ValueArgType&& value, tree_t& right)
+   {
+      static_assert(NodeType::alloc_t::movable_nodes,
+                    "nodes of this allocation policy cannot change trees");
+      m_impl.join(m_arena, m_root, right.m_root, key,
+                  std::forward<ValueArgType>(value));
+      m_max = tree_max(m_root.get());
+      m_size += 1 + right.m_size;
+      right.m_max = nullptr;
+      right.m_size = 0;
+   }
+
+   // Appends the elements of right, whose keys must all be greater than
+   // those of the tree, in O(log n). right is left empty.
+   void join(tree_t& right)
+   {
+      static_assert(NodeType::alloc_t::movable_nodes,
+                    "nodes of this allocation policy cannot change trees");
+      m_impl.join(m_root, right.m_root);
+      if (right.m_max)
+         m_max = right.m_max;
+      m_size += right.m_size;
+      right.m_max = nullptr;
+      right.m_size = 0;
+   }
+
+   // Moves the elements whose keys are not less than key to the returned
+   // tree, in O(log n).
+   tree_t split(const key_t& key)
+   {
+      static_assert(NodeType::alloc_t::movable_nodes,
+                    "nodes of this allocation policy cannot change trees");
+      tree_t right(m_less);
+      m_impl.split(m_root, right.m_root, key);
+      if (right.m_root)
+      {
+         right.m_max = m_max;
+         m_max = tree_max(m_root.get());
+      }
+      right.m_size = node_count(right.m_root);
+      m_size -= right.m_size;
+      return right;
+   }
+
+   // Replaces the elements of the tree with their union, intersection or
+   // difference with those of other, which is left empty, reusing the nodes
+   // (see set_union). Needs the same as join; nb_threads bounds the
+   // concurrency of the recursion, with a few tasks per thread to even out
+   // uneven splits.
+   void combine(tree_t& other, set_op_t op, std::size_t nb_threads = 1)
+   {
+      static_assert(NodeType::alloc_t::movable_nodes,
+                    "nodes of this allocation policy cannot change trees");
+      const unsigned depth =
+         nb_threads > 1 ? bit_width(nb_threads - 1) + 2 : 0;
+      m_impl.combine(m_root, other.m_root, op, depth);
+      m_max = tree_max(m_root.get());
+      m_size = node_count(m_root);
+      other.m_max = nullptr;
+      other.m_size = 0;
    }
 
    value_t* get(const key_t& key) const
    {
-      const auto& n = _get(m_root, key);
-      if (!n)
-         return nullptr;
-      return &n->m_value;
+      return _get_value(key);
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   value_t* get(const KeyArgType& key) const
+   {
+      return _get_value(key);
    }
 
+   // Looks up every key of [begin, end) and writes to out, in the same
+   // order, a pointer to its value or nullptr. The lookups go down the tree
+   // in groups, one level per round, and the next node of each is
+   // prefetched a round before it is compared to, so that the cache misses
+   // of a group overlap instead of stalling one after the other.
+   template <typename KeyIteratorType, typename OutputIteratorType>
+   OutputIteratorType get_many(KeyIteratorType begin, KeyIteratorType end,
+                               OutputIteratorType out) const
+   {
+      constexpr std::size_t group_size = 16;
+      KeyIteratorType keys[group_size];
+      NodeType* nodes[group_size];
+      value_t* found[group_size];
+
+      while (begin != end)
+      {
+         std::size_t n = 0;
+         for (; n < group_size && begin != end; ++n, ++begin)
+         {
+            keys[n] = begin;
+            nodes[n] = m_root.get();
+            found[n] = nullptr;
+         }
+
+         for (bool active = true; active;)
+         {
+            active = false;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+               auto node = nodes[i];
+               if (!node)
+                  continue;
+
+               if (m_less(*keys[i], node->m_key))
+               {
+                  node = node->m_left.get();
+               }
+               else if (m_less(node->m_key, *keys[i]))
+               {
+                  node = node->m_right.get();
+               }
+               else
+               {
+                  found[i] = &node->m_value;
+                  node = nullptr;
+               }
+
+               nodes[i] = node;
+               if (node)
+               {
+#if defined(__GNUC__)
+                  __builtin_prefetch(node);
+#endif
+                  active = true;
+               }
+            }
+         }
+
+         for (std::size_t i = 0; i < n; ++i)
+            *out++ = found[i];
+      }
+      return out;
+   }
+
+   // Only invalidates the iterators to the removed element.
    void remove(const key_t& key)
    {
-      m_impl.remove(m_root, key);
+      _remove(key);
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   void remove(const KeyArgType& key)
+   {
+      _remove(key);
    }
 
    std::size_t size() const
    {
-      return _size(m_root);
+      return m_size;
+   }
+
+   const LessType& key_comp() const
+   {
+      return m_less;
+   }
+
+   // Destroys all the nodes without recursing, so that degenerate trees
+   // do not exhaust the stack.
+   void clear()
+   {
+      while (m_root)
+      {
+         if (m_root->m_left)
+         {
+            auto left = std::move(m_root->m_left);
+            m_root->m_left = std::move(left->m_right);
+            left->m_right = std::move(m_root);
+            m_root = std::move(left);
+         }
+         else
+         {
+            auto right = std::move(m_root->m_right);
+            m_root = std::move(right);
+         }
+      }
+      m_max = nullptr;
+      m_size = 0;
+   }
+
+   // Number of keys strictly less than key.
+   std::size_t rank(const key_t& key) const
+   {
+      return _rank(key);
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   std::size_t rank(const KeyArgType& key) const
+   {
+      return _rank(key);
+   }
+
+   // Key of rank k (0 being the smallest key), nullptr if k >= size().
+   const key_t* select(std::size_t k) const
+   {
+      auto node = m_root.get();
+      while (node)
+      {
+         const auto l = node_count(node->m_left);
+         if (k < l)
+         {
+            node = node->m_left.get();
+         }
+         else if (k > l)
+         {
+            k -= l + 1;
+            node = node->m_right.get();
+         }
+         else
+         {
+            return &node->m_key;
+         }
+      }
+      return nullptr;
+   }
+
+   iterator begin() { return make_iterator(tree_min(m_root.get())); }
+
+   iterator end() { return make_iterator(nullptr); }
+
+   const_iterator begin() const
+   {
+      return make_iterator(tree_min(m_root.get()));
+   }
+
+   const_iterator end() const { return make_iterator(nullptr); }
+
+   // Smallest key, nullptr if the tree is empty.
+   const key_t* min() const
+   {
+      const auto node = tree_min(m_root.get());
+      return node ? &node->m_key : nullptr;
+   }
+
+   // Largest key, nullptr if the tree is empty.
+   const key_t* max() const
+   {
+      return m_max ? &m_max->m_key : nullptr;
+   }
+
+   // First element whose key is not less than key.
+   iterator lower_bound(const key_t& key)
+   {
+      return make_iterator(_lower_bound(key));
+   }
+
+   const_iterator lower_bound(const key_t& key) const
+   {
+      return make_iterator(_lower_bound(key));
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   iterator lower_bound(const KeyArgType& key)
+   {
+      return make_iterator(_lower_bound(key));
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   const_iterator lower_bound(const KeyArgType& key) const
+   {
+      return make_iterator(_lower_bound(key));
+   }
+
+   // First element whose key is greater than key.
+   iterator upper_bound(const key_t& key)
+   {
+      return make_iterator(_upper_bound(key));
+   }
+
+   const_iterator upper_bound(const key_t& key) const
+   {
+      return make_iterator(_upper_bound(key));
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   iterator upper_bound(const KeyArgType& key)
+   {
+      return make_iterator(_upper_bound(key));
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   const_iterator upper_bound(const KeyArgType& key) const
+   {
+      return make_iterator(_upper_bound(key));
+   }
+
+   // Elements whose keys lie in [lo, hi].
+   range_t<iterator> range(const key_t& lo, const key_t& hi)
+   {
+      return _range(lo, hi);
+   }
+
+   range_t<const_iterator> range(const key_t& lo, const key_t& hi) const
+   {
+      return _range(lo, hi);
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   range_t<iterator> range(const KeyArgType& lo, const KeyArgType& hi)
+   {
+      return _range(lo, hi);
+   }
+
+   template <typename KeyArgType, typename =
+             enable_if_transparent_t<LessType, KeyArgType>>
+   range_t<const_iterator> range(const KeyArgType& lo,
+                                 const KeyArgType& hi) const
+   {
+      return _range(lo, hi);
    }
 
 private:
+   arena_t m_arena;
    node_ptr_t m_root;
+   // Largest node, kept by every change to the tree. Nodes keep their
+   // elements while the impls rebalance, so it only moves on insertions past
+   // it and on its own removal.
+   NodeType* m_max = nullptr;
+   std::size_t m_size = 0;
    LessType m_less;
    ImplType m_impl;
 
-   const node_ptr_t& _get(const node_ptr_t& node, const key_t& key) const
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<iterator, bool> _emplace(KeyArgType&& key, ArgTypes&&... args)
    {
-      if (!node)
-         return node;
+      const auto r = emplace_node(std::forward<KeyArgType>(key),
+                                  std::forward<ArgTypes>(args)...);
+      if (r.second)
+         ++m_size;
+      return std::make_pair(make_iterator(r.first), r.second);
+   }
+
+   // The key is searched first so that value is forwarded once, either to
+   // the element found or to the new one.
+   template <typename KeyArgType, typename ValueArgType>
+   std::pair<iterator, bool> _insert_or_assign(KeyArgType&& key,
+                                               ValueArgType&& value)
+   {
+      NodeType* parent;
+      const auto link = find_link(key, parent);
+      if (*link)
+      {
+         (*link)->m_value = std::forward<ValueArgType>(value);
+         return std::make_pair(make_iterator(link->get()), false);
+      }
 
-      if (m_less(key, node->m_key))
-         return _get(node->m_left, key);
+      const bool last = is_last_link(parent, link);
+      const auto node = m_impl.emplace_at(m_arena, m_root, parent, *link,
+                                          std::forward<KeyArgType>(key),
+                                          std::forward<ValueArgType>(value));
+      if (last)
+         m_max = node;
+      ++m_size;
+      return std::make_pair(make_iterator(node), true);
+   }
 
-      if (m_less(node->m_key, key))
-         return _get(node->m_right, key);
+   // Keys past the largest one, as in time series, are appended to it
+   // after a single comparison; the others are searched from the root.
+   template <typename KeyArgType, typename... ArgTypes>
+   std::pair<NodeType*, bool> emplace_node(KeyArgType&& key,
+                                           ArgTypes&&... args)
+   {
+      if (m_max && m_less(m_max->m_key, key))
+      {
+         m_max = m_impl.emplace_at(m_arena, m_root, m_max, m_max->m_right,
+                                   std::forward<KeyArgType>(key),
+                                   std::forward<ArgTypes>(args)...);
+         return std::make_pair(m_max, true);
+      }
 
-      return node;
+      const auto r = m_impl.emplace(m_arena, m_root,
+                                    std::forward<KeyArgType>(key),
+                                    std::forward<ArgTypes>(args)...);
+      if (!m_max)
+         m_max = r.first;
+      return r;
+   }
+
+   template <typename KeyArgType, typename ValueArgType>
+   iterator _put_hint(const_iterator hint, KeyArgType&& key,
+                      ValueArgType&& value)
+   {
+      if (!m_root)
+         return _insert_or_assign(std::forward<KeyArgType>(key),
+                                  std::forward<ValueArgType>(value)).first;
+
+      NodeType* parent;
+      const auto link = find_link(hint.node() ? hint.node() : m_max, key,
+                                  parent);
+      if (*link)
+      {
+         (*link)->m_value = std::forward<ValueArgType>(value);
+         return make_iterator(link->get());
+      }
+
+      const bool last = is_last_link(parent, link);
+      const auto node = m_impl.emplace_at(m_arena, m_root, parent, *link,
+                                          std::forward<KeyArgType>(key),
+                                          std::forward<ValueArgType>(value));
+      if (last)
+         m_max = node;
+      ++m_size;
+      return make_iterator(node);
    }
 
-   std::size_t _size(const node_ptr_t& node) const
+   // Rebuilds the tree with the elements of a sorted batch without
+   // duplicates, which override those of the tree, in linear time. Only the
+   // new keys get nodes, the others are relinked as they are, so that
+   // nothing is copied and a failure to create the new nodes leaves the tree
+   // as it was. The values of the keys already present are assigned last.
+   void rebuild_with(std::vector<std::pair<key_t, value_t>>& batch)
    {
-      if (!node)
-         return 0;
-      return 1 + _size(node->m_left) + _size(node->m_right);
+      std::vector<NodeType*> nodes;
+      nodes.reserve(m_size);
+      for (auto node = tree_min(m_root.get()); node; node = tree_next(node))
+         nodes.push_back(node);
+
+      // whether each element of the result comes from the batch
+      std::vector<bool> from_batch;
+      from_batch.reserve(nodes.size() + batch.size());
+      std::vector<std::pair<NodeType*, value_t*>> updates;
+      std::vector<std::pair<key_t, value_t>> added;
+      added.reserve(batch.size());
+      std::size_t i = 0;
+      for (auto& kv : batch)
+      {
+         for (; i < nodes.size() && m_less(nodes[i]->m_key, kv.first); ++i)
+            from_batch.push_back(false);
+         if (i < nodes.size() && !m_less(kv.first, nodes[i]->m_key))
+         {
+            updates.emplace_back(nodes[i], &kv.second);
+            continue;
+         }
+         from_batch.push_back(true);
+         added.push_back(std::move(kv));
+      }
+      from_batch.resize(nodes.size() + added.size(), false);
+
+      std::vector<node_ptr_t> merged;
+      merged.reserve(from_batch.size());
+      auto first_added = std::make_move_iterator(added.begin());
+      auto added_root = ImplType::build(m_arena, first_added, added.size());
+
+      // nothing below throws until the assignments
+      auto next_added = tree_min(added_root.get());
+      auto next_node = nodes.begin();
+      for (const bool b : from_batch)
+      {
+         if (b)
+         {
+            merged.emplace_back(next_added);
+            next_added = tree_next(next_added);
+         }
+         else
+            merged.emplace_back(*next_node++);
+      }
+      for (auto& node : merged)
+      {
+         node->m_left.release();
+         node->m_right.release();
+      }
+      m_root.release();
+      added_root.release();
+
+      auto first = merged.data();
+      m_root = ImplType::build(m_arena, first, merged.size());
+      m_max = tree_max(m_root.get());
+      m_size = merged.size();
+
+      for (auto& update : updates)
+         update.first->m_value = std::move(*update.second);
+   }
+
+   // Finger search: climbs from finger to the lowest ancestor whose subtree
+   // spans key, comparing only with the ancestors that bound the subtrees
+   // on the side of key, then descends. Returns the link that holds key or
+   // would, and its node in parent.
+   node_ptr_t* find_link(NodeType* finger, const key_t& key,
+                         NodeType*& parent)
+   {
+      auto x = finger;
+      const bool before = m_less(key, x->m_key);
+      for (auto c = x, p = x->parent(); p; c = p, p = p->parent())
+      {
+         if ((p->m_left.get() == c) == before)
+            continue;
+         if (before ? m_less(p->m_key, key) : m_less(key, p->m_key))
+            break;
+         x = p;
+      }
+
+      parent = x->parent();
+      auto link = !parent ? &m_root :
+         parent->m_left.get() == x ? &parent->m_left : &parent->m_right;
+      return descend(link, key, parent);
+   }
+
+   // Same as find_link from the root, appending past the largest key as
+   // emplace_node does.
+   node_ptr_t* find_link(const key_t& key, NodeType*& parent)
+   {
+      if (m_max && m_less(m_max->m_key, key))
+      {
+         parent = m_max;
+         return &m_max->m_right;
+      }
+      parent = nullptr;
+      return descend(&m_root, key, parent);
+   }
+
+   // Whether a node created in link, whose node is in parent, is the new
+   // largest one.
+   bool is_last_link(const NodeType* parent, const node_ptr_t* link) const
+   {
+      return !m_max || (parent == m_max && link == &m_max->m_right);
+   }
+
+   // Follows the links from link, whose node is in parent, down to the one
+   // that holds key or would.
+   node_ptr_t* descend(node_ptr_t* link, const key_t& key,
+                       NodeType*& parent) const
+   {
+      while (*link)
+      {
+         const auto node = link->get();
+         if (m_less(key, node->m_key))
+            link = &node->m_left;
+         else if (m_less(node->m_key, key))
+            link = &node->m_right;
+         else
+            break;
+         parent = node;
+      }
+      return link;
+   }
+
+   iterator make_iterator(NodeType* node)
+   {
+      return iterator(node, &m_root);
+   }
+
+   const_iterator make_iterator(NodeType* node) const
+   {
+      return const_iterator(node, &m_root);
+   }
+
+   template <typename KeyArgType>
+   value_t* _get_value(const KeyArgType& key) const
+   {
+      const auto n = _get(key);
+      if (!n)
+         return nullptr;
+      return &n->m_value;
+   }
+
+   template <typename KeyArgType>
+   void _remove(const KeyArgType& key)
+   {
+      // a key past the largest one is missing, an equal one removes it
+      const bool last = m_max && !m_less(key, m_max->m_key);
+      if (m_impl.remove(m_root, key))
+      {
+         if (last)
+            m_max = tree_max(m_root.get());
+         --m_size;
+      }
+   }
+
+   template <typename KeyArgType>
+   std::size_t _rank(const KeyArgType& key) const
+   {
+      std::size_t r = 0;
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+         {
+            node = node->m_left.get();
+         }
+         else if (m_less(node->m_key, key))
+         {
+            r += 1 + node_count(node->m_left);
+            node = node->m_right.get();
+         }
+         else
+         {
+            return r + node_count(node->m_left);
+         }
+      }
+      return r;
+   }
+
+   template <typename KeyArgType>
+   range_t<iterator> _range(const KeyArgType& lo, const KeyArgType& hi)
+   {
+      if (m_less(hi, lo))
+         return range_t<iterator>(end(), end());
+      return range_t<iterator>(make_iterator(_lower_bound(lo)),
+                               make_iterator(_upper_bound(hi)));
+   }
+
+   template <typename KeyArgType>
+   range_t<const_iterator> _range(const KeyArgType& lo,
+                                  const KeyArgType& hi) const
+   {
+      if (m_less(hi, lo))
+         return range_t<const_iterator>(end(), end());
+      return range_t<const_iterator>(make_iterator(_lower_bound(lo)),
+                                     make_iterator(_upper_bound(hi)));
+   }
+
+   template <typename KeyArgType>
+   NodeType* _lower_bound(const KeyArgType& key) const
+   {
+      NodeType* candidate = nullptr;
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(node->m_key, key))
+         {
+            node = node->m_right.get();
+         }
+         else
+         {
+            candidate = node;
+            node = node->m_left.get();
+         }
+      }
+      return candidate;
+   }
+
+   template <typename KeyArgType>
+   NodeType* _upper_bound(const KeyArgType& key) const
+   {
+      NodeType* candidate = nullptr;
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+         {
+            candidate = node;
+            node = node->m_left.get();
+         }
+         else
+         {
+            node = node->m_right.get();
+         }
+      }
+      return candidate;
+   }
+
+   template <typename KeyArgType>
+   NodeType* _get(const KeyArgType& key) const
+   {
+      auto node = m_root.get();
+      while (node)
+      {
+         if (m_less(key, node->m_key))
+            node = node->m_left.get();
+         else if (m_less(node->m_key, key))
+            node = node->m_right.get();
+         else
+            break;
+      }
+      return node;
    }
 };
 
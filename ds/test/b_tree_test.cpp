@@ -0,0 +1,281 @@
+#include <ds/b_tree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <std::size_t Fanout>
+struct b_tree_factory_t
+{
+   template <typename T, typename V = T>
+   static ds::b_tree_t<T, V, std::less<T>, Fanout> instance()
+   {
+      return ds::b_tree_t<T, V, std::less<T>, Fanout>();
+   }
+};
+
+struct default_b_tree_factory_t
+{
+   template <typename T, typename V = T>
+   static ds::b_tree_t<T, V> instance()
+   {
+      return ds::b_tree_t<T, V>();
+   }
+};
+
+template <typename TreeType, typename KeyType, typename ValueType>
+static bool same_content(const TreeType& t,
+                         const std::map<KeyType, ValueType>& m)
+{
+   if (t.size() != m.size())
+      return false;
+
+   auto it = m.begin();
+   for (auto kv: t)
+   {
+      if (it == m.end() || kv.first != it->first || kv.second != it->second)
+         return false;
+      ++it;
+   }
+   return it == m.end();
+}
+
+template <typename TreeFactoryType>
+struct prop_put_remove_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+      }
+      if (!same_content(t, m))
+         return false;
+
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+      {
+         t.remove(xs[i]);
+         m.erase(xs[i]);
+         if (t.size() != m.size() || t.get(xs[i]))
+            return false;
+      }
+      return same_content(t, m);
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+template <class T>
+class b_tree_test_t: public testing::Test
+{};
+
+using b_tree_factory_types_t =
+   testing::Types<b_tree_factory_t<4>, b_tree_factory_t<5>,
+                  default_b_tree_factory_t>;
+
+TYPED_TEST_CASE(b_tree_test_t, b_tree_factory_types_t);
+
+TYPED_TEST(b_tree_test_t, basic)
+{
+   auto t = TypeParam::template instance<int>();
+   EXPECT_EQ(0u, t.size());
+   EXPECT_EQ(nullptr, t.get(1));
+   EXPECT_TRUE(t.begin() == t.end());
+   t.remove(1);
+
+   t.put(2, 20);
+   t.put(1, 10);
+   t.put(2, 21);
+   EXPECT_EQ(2u, t.size());
+   ASSERT_TRUE(t.get(2) != nullptr);
+   EXPECT_EQ(21, *t.get(2));
+
+   t.remove(1);
+   t.remove(3);
+   EXPECT_EQ(1u, t.size());
+   EXPECT_EQ(nullptr, t.get(1));
+
+   t.remove(2);
+   EXPECT_EQ(0u, t.size());
+   EXPECT_TRUE(t.begin() == t.end());
+}
+
+TYPED_TEST(b_tree_test_t, put_remove_int)
+{
+   check_prop<prop_put_remove_t<TypeParam>, int>();
+}
+
+TYPED_TEST(b_tree_test_t, put_remove_string)
+{
+   check_prop<prop_put_remove_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(b_tree_test_t, random_ops)
+{
+   auto t = TypeParam::template instance<int>();
+   std::map<int, int> m;
+   std::mt19937 gen(7);
+   std::uniform_int_distribution<int> key(0, 4000);
+
+   for (int i = 0; i < 40000; ++i)
+   {
+      const auto k = key(gen);
+      if (gen() % 3)
+      {
+         t.put(k, i);
+         m[k] = i;
+      }
+      else
+      {
+         t.remove(k);
+         m.erase(k);
+      }
+   }
+   EXPECT_TRUE(same_content(t, m));
+
+   for (const auto& kv: m)
+      t.remove(kv.first);
+   EXPECT_EQ(0u, t.size());
+   EXPECT_TRUE(t.begin() == t.end());
+}
+
+TYPED_TEST(b_tree_test_t, lower_bound)
+{
+   auto t = TypeParam::template instance<int>();
+   for (int i = 0; i < 200; i += 2)
+      t.put(i, i);
+
+   const auto& ct = t;
+   for (int i = -1; i < 199; ++i)
+   {
+      auto it = ct.lower_bound(i);
+      ASSERT_TRUE(it != ct.end());
+      EXPECT_EQ(i < 0 ? 0 : (i + 1) / 2 * 2, it->first);
+   }
+   EXPECT_TRUE(t.lower_bound(199) == t.end());
+
+   t.lower_bound(10)->second = 11;
+   EXPECT_EQ(11, *t.get(10));
+}
+
+TYPED_TEST(b_tree_test_t, move_only_value)
+{
+   auto t = TypeParam::template instance<int, std::unique_ptr<int>>();
+   for (int i = 0; i < 64; ++i)
+      t.put(i, std::unique_ptr<int>(new int(i)));
+   for (int i = 0; i < 64; i += 2)
+      t.remove(i);
+
+   for (int i = 1; i < 64; i += 2)
+   {
+      auto v = t.get(i);
+      ASSERT_TRUE(v != nullptr);
+      EXPECT_EQ(i, **v);
+   }
+
+   auto moved = std::move(t);
+   EXPECT_EQ(0u, t.size());
+   EXPECT_EQ(32u, moved.size());
+}
+
+TEST(b_tree_search_test_t, mixed_sign_keys)
+{
+   ds::b_tree_t<unsigned, int, std::less<unsigned>, 8> t;
+   const unsigned keys[] = {0u, 1u, 0x7fffffffu, 0x80000000u, 0xfffffffeu,
+                            0xffffffffu};
+   for (auto k : keys)
+      t.put(k, 1);
+   for (auto k : keys)
+      EXPECT_TRUE(t.get(k) != nullptr);
+   EXPECT_EQ(nullptr, t.get(2u));
+   EXPECT_EQ(0x80000000u, t.lower_bound(0x7fffffffu + 1u)->first);
+
+   ds::b_tree_t<long long, int> w;
+   for (long long k = -1000; k < 1000; ++k)
+      w.put(k * 3000000000LL, 1);
+   EXPECT_TRUE(w.get(-3000000000LL) != nullptr);
+   EXPECT_EQ(nullptr, w.get(-1));
+   EXPECT_EQ(1000u, static_cast<std::size_t>(
+                       std::distance(w.lower_bound(0), w.end())));
+}
+
+#ifdef DS_SIMD_X86
+
+template <typename KeyType>
+static void check_kernels()
+{
+   using search_t = ds::detail::simd_search_t<KeyType>;
+   using limits_t = std::numeric_limits<KeyType>;
+
+   std::mt19937_64 gen(3);
+   for (std::size_t n = 0; n < 40; ++n)
+   {
+      std::vector<KeyType> keys(n);
+      for (auto& k : keys)
+         k = static_cast<KeyType>(gen() % 64) +
+            (gen() % 2 ? limits_t::max() / 2 : KeyType(0));
+      keys.push_back(limits_t::min());
+      keys.push_back(limits_t::max());
+      std::sort(keys.begin(), keys.end());
+      keys.resize(n);
+
+      std::vector<KeyType> probes(keys);
+      probes.push_back(limits_t::min());
+      probes.push_back(limits_t::max());
+      probes.push_back(KeyType(7));
+
+      for (auto level : {ds::detail::simd_level_t::scalar,
+                         ds::detail::simd_level_t::sse,
+                         ds::detail::simd_level_t::avx2})
+      {
+         if (level > ds::detail::simd_level())
+            continue;
+         const auto less = search_t::kernel(level, false);
+         const auto less_equal = search_t::kernel(level, true);
+         for (auto p : probes)
+         {
+            const auto lb = std::lower_bound(keys.begin(), keys.end(), p);
+            const auto ub = std::upper_bound(keys.begin(), keys.end(), p);
+            EXPECT_EQ(static_cast<std::size_t>(lb - keys.begin()),
+                      less(keys.data(), n, p));
+            EXPECT_EQ(static_cast<std::size_t>(ub - keys.begin()),
+                      less_equal(keys.data(), n, p));
+         }
+      }
+   }
+}
+
+TEST(b_tree_search_test_t, kernels)
+{
+   check_kernels<std::int32_t>();
+   check_kernels<std::uint32_t>();
+   check_kernels<std::int64_t>();
+   check_kernels<std::uint64_t>();
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include <ds/coro_lookup.hpp>
+
+#include <gtest/gtest.h>
+
+#ifdef DS_HAS_COROUTINES
+
+#include <ds/bs_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+template <class T>
+class coro_lookup_test_t: public testing::Test
+{};
+
+using tree_types_t =
+   testing::Types<ds::bs_tree_t<int, int>, ds::rb_tree_t<int, int>,
+                  ds::compact_rb_tree_t<int, int>>;
+
+TYPED_TEST_CASE(coro_lookup_test_t, tree_types_t);
+
+TYPED_TEST(coro_lookup_test_t, empty)
+{
+   TypeParam t;
+   int dummy = 0;
+   int* v = &dummy;
+   typename TypeParam::const_iterator it;
+   std::size_t r = 1;
+
+   ds::lookup_scheduler_t s;
+   s.spawn(ds::co_get(t, 1, v));
+   s.spawn(ds::co_lower_bound(t, 1, it));
+   s.spawn(ds::co_rank(t, 1, r));
+   s.run();
+   EXPECT_EQ(nullptr, v);
+   EXPECT_TRUE(it == t.end());
+   EXPECT_EQ(0u, r);
+}
+
+TYPED_TEST(coro_lookup_test_t, mixed)
+{
+   std::mt19937 gen(5);
+   std::uniform_int_distribution<int> key(0, 3000);
+
+   TypeParam t;
+   for (int i = 0; i < 1000; ++i)
+   {
+      const auto k = key(gen);
+      t.put(k, i);
+   }
+
+   const std::size_t nb_probes = 500;
+   std::vector<int> probes(nb_probes);
+   for (auto& p : probes)
+      p = key(gen);
+
+   for (std::size_t width : {1, 3, 32})
+   {
+      std::vector<int*> values(nb_probes);
+      std::vector<typename TypeParam::const_iterator> bounds(nb_probes);
+      std::vector<std::size_t> ranks(nb_probes);
+
+      ds::lookup_scheduler_t s(width);
+      for (std::size_t i = 0; i < nb_probes; ++i)
+      {
+         switch (i % 3)
+         {
+         case 0:
+            s.spawn(ds::co_get(t, probes[i], values[i]));
+            break;
+         case 1:
+            s.spawn(ds::co_lower_bound(t, probes[i], bounds[i]));
+            break;
+         default:
+            s.spawn(ds::co_rank(t, probes[i], ranks[i]));
+         }
+      }
+      s.run();
+
+      const auto& ct = t;
+      for (std::size_t i = 0; i < nb_probes; ++i)
+      {
+         switch (i % 3)
+         {
+         case 0:
+            EXPECT_EQ(t.get(probes[i]), values[i]);
+            break;
+         case 1:
+            EXPECT_TRUE(ct.lower_bound(probes[i]) == bounds[i]);
+            break;
+         default:
+            EXPECT_EQ(t.rank(probes[i]), ranks[i]);
+         }
+      }
+   }
+}
+
+// Throws on negative keys, which are never stored.
+struct throwing_less_t
+{
+   bool operator()(int a, int b) const
+   {
+      if (a < 0 || b < 0)
+         throw std::runtime_error("negative key");
+      return a < b;
+   }
+};
+
+TEST(coro_lookup_test_t, throwing_comparator)
+{
+   ds::rb_tree_t<int, int, throwing_less_t> t;
+   for (int i = 0; i < 100; ++i)
+      t.put(i, i);
+
+   // a narrow scheduler fails in spawn, a wide one in run
+   for (std::size_t width : {2, 32})
+   {
+      const int n = 8;
+      std::vector<int*> values(n, nullptr);
+      int* failed = nullptr;
+      std::size_t nb_errors = 0;
+      ds::lookup_scheduler_t s(width);
+      for (int i = 0; i < n; ++i)
+      {
+         try
+         {
+            s.spawn(ds::co_get(t, 10 * i + 5, values[i]));
+            if (i == n / 2)
+               s.spawn(ds::co_get(t, -1, failed));
+         }
+         catch (const std::runtime_error&)
+         {
+            ++nb_errors;
+         }
+      }
+
+      // the failed lookup is gone, running again completes the others
+      for (bool done = false; !done;)
+      {
+         try
+         {
+            s.run();
+            done = true;
+         }
+         catch (const std::runtime_error&)
+         {
+            ++nb_errors;
+         }
+      }
+
+      EXPECT_EQ(1u, nb_errors);
+      EXPECT_EQ(nullptr, failed);
+      for (int i = 0; i < n; ++i)
+         EXPECT_EQ(t.get(10 * i + 5), values[i]);
+   }
+}
+
+TEST(coro_lookup_test_t, string_keys)
+{
+   ds::rb_tree_t<std::string, int> t;
+   const char* names[] = {"ada", "bob", "carl", "dan", "eve"};
+   for (int i = 0; i < 5; ++i)
+      t.put(names[i], i);
+
+   int* v = nullptr;
+   int* missing = nullptr;
+   std::size_t r = 0;
+   ds::lookup_scheduler_t s(2);
+   s.spawn(ds::co_get(t, std::string("dan"), v));
+   s.spawn(ds::co_get(t, std::string("zed"), missing));
+   s.spawn(ds::co_rank(t, std::string("cb"), r));
+   s.run();
+
+   ASSERT_TRUE(v != nullptr);
+   EXPECT_EQ(3, *v);
+   EXPECT_EQ(nullptr, missing);
+   EXPECT_EQ(3u, r);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include <ds/frozen_tree.hpp>
+#include <ds/bs_tree.hpp>
+#include <ds/rb_tree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <typename LayoutType>
+struct prop_freeze_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      ds::rb_tree_t<T, T> t;
+      for (const auto& x : xs)
+         t.put(x, x);
+      const auto f = ds::freeze<LayoutType>(t);
+      const std::set<T> ss(xs.begin(), xs.end());
+
+      if (f.size() != ss.size() ||
+          !std::equal(ss.begin(), ss.end(), f.begin(),
+                      [](const T& x, std::pair<const T&, const T&> kv) {
+                         return x == kv.first && x == kv.second;
+                      }))
+         return false;
+
+      for (const auto& x : xs)
+      {
+         const auto v = f.get(x);
+         if (!v || *v != x || f.rank(x) != t.rank(x))
+            return false;
+      }
+      return true;
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+template <class T>
+class frozen_tree_test_t: public testing::Test
+{};
+
+using layout_types_t =
+   testing::Types<ds::eytzinger_layout_t, ds::veb_layout_t>;
+
+TYPED_TEST_CASE(frozen_tree_test_t, layout_types_t);
+
+TYPED_TEST(frozen_tree_test_t, empty)
+{
+   ds::rb_tree_t<int, int> t;
+   const auto f = ds::freeze<TypeParam>(t);
+   EXPECT_EQ(0u, f.size());
+   EXPECT_EQ(nullptr, f.get(1));
+   EXPECT_EQ(0u, f.rank(1));
+   EXPECT_TRUE(f.lower_bound(1) == f.end());
+   EXPECT_TRUE(f.begin() == f.end());
+}
+
+TYPED_TEST(frozen_tree_test_t, freeze_int)
+{
+   check_prop<prop_freeze_t<TypeParam>, int>();
+}
+
+TYPED_TEST(frozen_tree_test_t, freeze_string)
+{
+   check_prop<prop_freeze_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(frozen_tree_test_t, every_size)
+{
+   // odd keys only, so that every even probe falls in a gap
+   for (int n = 1; n < 300; ++n)
+   {
+      ds::bs_tree_t<int, int> t;
+      for (int i = 0; i < n; ++i)
+         t.put(2 * i + 1, i);
+      const auto f = ds::freeze<TypeParam>(t);
+      ASSERT_EQ(static_cast<std::size_t>(n), f.size());
+
+      for (int k = 0; k <= 2 * n; ++k)
+      {
+         const auto r = static_cast<std::size_t>(k / 2);
+         EXPECT_EQ(r, f.rank(k));
+         const auto v = f.get(k);
+         if (k % 2)
+         {
+            ASSERT_TRUE(v != nullptr);
+            EXPECT_EQ(k / 2, *v);
+         }
+         else
+         {
+            EXPECT_EQ(nullptr, v);
+         }
+
+         const auto it = f.lower_bound(k);
+         if (k < 2 * n)
+            EXPECT_EQ(k | 1, it->first);
+         else
+            EXPECT_TRUE(it == f.end());
+      }
+   }
+}
+
+TEST(veb_layout_test_t, positions)
+{
+   // root, then the bottom trees under it: 2 4 5 and 3 6 7 breadth-first
+   const std::vector<std::size_t> expected = {3, 2, 4, 1, 6, 5, 7};
+   EXPECT_EQ(expected, ds::veb_layout_t::positions(7));
+
+   for (std::size_t n = 0; n < 1100; ++n)
+   {
+      auto pos = ds::veb_layout_t::positions(n);
+      std::sort(pos.begin(), pos.end());
+      for (std::size_t i = 0; i < n; ++i)
+         ASSERT_EQ(i + 1, pos[i]);
+   }
+}
@@ -0,0 +1,164 @@
+#include <ds/persistent_rb_tree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <typename TreeType, typename KeyType, typename ValueType>
+static bool same_content(const TreeType& t,
+                         const std::map<KeyType, ValueType>& m)
+{
+   if (t.size() != m.size())
+      return false;
+
+   auto it = m.begin();
+   for (auto kv: t)
+   {
+      if (it == m.end() || kv.first != it->first || kv.second != it->second)
+         return false;
+      ++it;
+   }
+   return it == m.end();
+}
+
+// Every version keeps its content while later ones are built out of it.
+struct prop_versions_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      ds::persistent_rb_tree_t<T, T> t;
+      std::vector<ds::persistent_rb_tree_t<T, T>> versions;
+      std::vector<std::map<T, T>> maps;
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         versions.push_back(t.snapshot());
+         maps.push_back(m);
+         t.put(xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+      }
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+      {
+         versions.push_back(t.snapshot());
+         maps.push_back(m);
+         t.remove(xs[i]);
+         m.erase(xs[i]);
+         if (t.get(xs[i]))
+            return false;
+      }
+      versions.push_back(t);
+      maps.push_back(m);
+
+      for (std::size_t i = 0; i < versions.size(); ++i)
+      {
+         if (!same_content(versions[i], maps[i]))
+            return false;
+      }
+      for (const auto& x : xs)
+      {
+         if (t.rank(x) != static_cast<std::size_t>(
+                std::distance(m.begin(), m.lower_bound(x))))
+            return false;
+      }
+      return true;
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+TEST(persistent_rb_tree_test_t, basic)
+{
+   ds::persistent_rb_tree_t<int, int> t;
+   EXPECT_EQ(0u, t.size());
+   EXPECT_EQ(nullptr, t.get(1));
+   EXPECT_TRUE(t.begin() == t.end());
+   t.remove(1);
+
+   t.put(2, 20);
+   t.put(1, 10);
+   const auto s = t.snapshot();
+   t.put(2, 21);
+   t.remove(1);
+
+   EXPECT_EQ(1u, t.size());
+   EXPECT_EQ(21, *t.get(2));
+   EXPECT_EQ(nullptr, t.get(1));
+
+   EXPECT_EQ(2u, s.size());
+   EXPECT_EQ(20, *s.get(2));
+   EXPECT_EQ(10, *s.get(1));
+
+   t.clear();
+   EXPECT_EQ(0u, t.size());
+   EXPECT_EQ(2u, s.size());
+}
+
+TEST(persistent_rb_tree_test_t, versions_int)
+{
+   check_prop<prop_versions_t, int>();
+}
+
+TEST(persistent_rb_tree_test_t, versions_string)
+{
+   check_prop<prop_versions_t, std::string>();
+}
+
+TEST(persistent_rb_tree_test_t, concurrent_snapshots)
+{
+   // the writer inserts keys in order: a version of size n holds [0, n)
+   const int n = 2000;
+   ds::persistent_rb_tree_t<int, int> t;
+   std::atomic<bool> done(false);
+   std::atomic<bool> consistent(true);
+
+   std::vector<std::thread> readers;
+   for (int r = 0; r < 3; ++r)
+   {
+      readers.emplace_back([&] {
+         while (!done)
+         {
+            const auto s = t.snapshot();
+            const auto size = static_cast<int>(s.size());
+            int expected = 0;
+            for (auto kv : s)
+            {
+               if (kv.first != expected || kv.second != -expected)
+                  consistent = false;
+               ++expected;
+            }
+            if (expected != size || (size > 0 && !s.get(size - 1)) ||
+                s.get(size))
+               consistent = false;
+         }
+      });
+   }
+
+   for (int i = 0; i < n; ++i)
+      t.put(i, -i);
+   for (int i = n - 1; i >= n / 2; --i)
+      t.remove(i);
+   done = true;
+   for (auto& r : readers)
+      r.join();
+
+   EXPECT_TRUE(consistent);
+   EXPECT_EQ(static_cast<std::size_t>(n / 2), t.size());
+}
@@ -0,0 +1,181 @@
+#include <ds/rcu_map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <typename KeyType, typename ValueType>
+static bool same_content(const ds::rcu_map_t<KeyType, ValueType>& t,
+                         const std::map<KeyType, ValueType>& m)
+{
+   std::vector<std::pair<KeyType, ValueType>> kvs;
+   t.for_each([&](const KeyType& k, const ValueType& v) {
+      kvs.emplace_back(k, v);
+   });
+   return t.size() == m.size() &&
+      std::vector<std::pair<KeyType, ValueType>>(m.begin(), m.end()) == kvs;
+}
+
+struct prop_put_remove_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      ds::rcu_map_t<T, T> t;
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+      }
+      if (!same_content(t, m))
+         return false;
+
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+      {
+         t.remove(xs[i]);
+         m.erase(xs[i]);
+         T v;
+         if (t.get(xs[i], v) || t.contains(xs[i]))
+            return false;
+      }
+      for (const auto& x : xs)
+      {
+         if (t.rank(x) != static_cast<std::size_t>(
+                std::distance(m.begin(), m.lower_bound(x))))
+            return false;
+      }
+      return same_content(t, m);
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+// Counts the instances alive, so that leaks and early frees show.
+struct counted_t
+{
+   static int& nb_alive()
+   {
+      static int n = 0;
+      return n;
+   }
+
+   counted_t(int v = 0): m_v(v) { ++nb_alive(); }
+   counted_t(const counted_t& other): m_v(other.m_v) { ++nb_alive(); }
+   counted_t& operator=(const counted_t&) = default;
+   ~counted_t() { --nb_alive(); }
+
+   int m_v;
+};
+
+TEST(rcu_map_test_t, basic)
+{
+   ds::rcu_map_t<int, int> t;
+   int v = 0;
+   EXPECT_EQ(0u, t.size());
+   EXPECT_FALSE(t.get(1, v));
+   t.remove(1);
+
+   t.put(2, 20);
+   t.put(1, 10);
+   t.put(2, 21);
+   EXPECT_EQ(2u, t.size());
+   ASSERT_TRUE(t.get(2, v));
+   EXPECT_EQ(21, v);
+
+   t.remove(1);
+   EXPECT_EQ(1u, t.size());
+   EXPECT_FALSE(t.contains(1));
+   EXPECT_EQ(1u, t.rank(3));
+}
+
+TEST(rcu_map_test_t, put_remove_int)
+{
+   check_prop<prop_put_remove_t, int>();
+}
+
+TEST(rcu_map_test_t, put_remove_string)
+{
+   check_prop<prop_put_remove_t, std::string>();
+}
+
+TEST(rcu_map_test_t, reclaim)
+{
+   {
+      ds::rcu_map_t<int, counted_t> t;
+      for (int i = 0; i < 1000; ++i)
+         t.put(i % 300, counted_t(i));
+      for (int i = 0; i < 100; ++i)
+         t.remove(i);
+
+      // without readers, every retired node is freed by the next update
+      EXPECT_EQ(200, counted_t::nb_alive());
+
+      // a reader holds back the nodes retired since it started
+      {
+         ds::detail::epoch_domain_t::guard_t guard;
+         t.put(150, counted_t());
+         EXPECT_LT(200, counted_t::nb_alive());
+      }
+      t.put(150, counted_t());
+      EXPECT_EQ(200, counted_t::nb_alive());
+   }
+   EXPECT_EQ(0, counted_t::nb_alive());
+}
+
+TEST(rcu_map_test_t, concurrent_readers)
+{
+   // the writer inserts keys in order: a version of size n holds [0, n)
+   const int n = 2000;
+   ds::rcu_map_t<int, int> t;
+   std::atomic<bool> done(false);
+   std::atomic<bool> consistent(true);
+
+   std::vector<std::thread> readers;
+   for (int r = 0; r < 3; ++r)
+   {
+      readers.emplace_back([&] {
+         while (!done)
+         {
+            int expected = 0;
+            t.for_each([&](int k, int v) {
+               if (k != expected || v != -k)
+                  consistent = false;
+               ++expected;
+            });
+
+            int v = 0;
+            if (t.get(expected, v) && v != -expected)
+               consistent = false;
+         }
+      });
+   }
+
+   for (int i = 0; i < n; ++i)
+      t.put(i, -i);
+   for (int i = n - 1; i >= n / 2; --i)
+      t.remove(i);
+   done = true;
+   for (auto& r : readers)
+      r.join();
+
+   EXPECT_TRUE(consistent);
+   EXPECT_EQ(static_cast<std::size_t>(n / 2), t.size());
+}
@@ -0,0 +1,153 @@
+#include <ds/sharded_map.hpp>
+#include <ds/bs_tree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <typename MapType>
+static bool same_content(
+   const MapType& t,
+   const std::map<typename MapType::key_t, typename MapType::value_t>& m)
+{
+   using kv_t = std::pair<typename MapType::key_t, typename MapType::value_t>;
+   std::vector<kv_t> kvs;
+   t.for_each([&](const typename MapType::key_t& k,
+                  const typename MapType::value_t& v) {
+      kvs.emplace_back(k, v);
+   });
+   return t.size() == m.size() && std::vector<kv_t>(m.begin(), m.end()) == kvs;
+}
+
+template <std::size_t nb_shards>
+struct prop_put_remove_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      ds::sharded_map_t<T, T> t(nb_shards);
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+      }
+      if (!same_content(t, m))
+         return false;
+
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+      {
+         t.remove(xs[i]);
+         m.erase(xs[i]);
+         T v;
+         if (t.get(xs[i], v) || t.contains(xs[i]))
+            return false;
+      }
+      for (const auto& kv : m)
+      {
+         T v;
+         if (!t.get(kv.first, v) || v != kv.second)
+            return false;
+      }
+      return same_content(t, m);
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+TEST(sharded_map_test_t, basic)
+{
+   ds::sharded_map_t<int, int> t(5);
+   EXPECT_EQ(8u, t.nb_shards());
+   int v = 0;
+   EXPECT_EQ(0u, t.size());
+   EXPECT_FALSE(t.get(1, v));
+   t.remove(1);
+
+   t.put(2, 20);
+   t.put(1, 10);
+   t.put(2, 21);
+   EXPECT_EQ(2u, t.size());
+   ASSERT_TRUE(t.get(2, v));
+   EXPECT_EQ(21, v);
+
+   t.remove(1);
+   EXPECT_EQ(1u, t.size());
+   EXPECT_FALSE(t.contains(1));
+   EXPECT_TRUE(t.contains(2));
+}
+
+TEST(sharded_map_test_t, put_remove_int)
+{
+   check_prop<prop_put_remove_t<1>, int>();
+   check_prop<prop_put_remove_t<16>, int>();
+}
+
+TEST(sharded_map_test_t, put_remove_string)
+{
+   check_prop<prop_put_remove_t<16>, std::string>();
+}
+
+TEST(sharded_map_test_t, other_tree)
+{
+   ds::sharded_map_t<int, int, ds::bs_tree_t<int, int, std::greater<int>>>
+      t(4);
+   for (int i = 0; i < 100; ++i)
+      t.put(i, -i);
+
+   // the merge follows the order of the trees
+   int expected = 99;
+   t.for_each([&](int k, int v) {
+      EXPECT_EQ(expected, k);
+      EXPECT_EQ(-k, v);
+      --expected;
+   });
+   EXPECT_EQ(-1, expected);
+}
+
+TEST(sharded_map_test_t, concurrent_writers)
+{
+   const int nb_threads = 4;
+   const int n = 1000;
+   ds::sharded_map_t<int, int> t(8);
+
+   std::vector<std::thread> writers;
+   for (int w = 0; w < nb_threads; ++w)
+   {
+      writers.emplace_back([&, w] {
+         for (int i = 0; i < n; ++i)
+         {
+            const auto k = i * nb_threads + w;
+            t.put(k, -k);
+            if (i % 2)
+               t.remove(k);
+         }
+      });
+   }
+   for (auto& w : writers)
+      w.join();
+
+   std::map<int, int> m;
+   for (int k = 0; k < nb_threads * n; ++k)
+   {
+      if (k / nb_threads % 2 == 0)
+         m[k] = -k;
+   }
+   EXPECT_TRUE(same_content(t, m));
+}
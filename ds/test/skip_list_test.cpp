@@ -0,0 +1,227 @@
+#include <ds/skip_list.hpp>
+
+#include <gtest/gtest.h>
+
+#include <autocheck/autocheck.hpp>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ac = autocheck;
+
+
+template <typename KeyType, typename ValueType>
+static bool same_content(const ds::skip_list_t<KeyType, ValueType>& t,
+                         const std::map<KeyType, ValueType>& m)
+{
+   std::vector<std::pair<KeyType, ValueType>> kvs;
+   t.for_each([&](const KeyType& k, const ValueType& v) {
+      kvs.emplace_back(k, v);
+   });
+   return t.size() == m.size() &&
+      std::vector<std::pair<KeyType, ValueType>>(m.begin(), m.end()) == kvs;
+}
+
+struct prop_put_remove_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      ds::skip_list_t<T, T> t;
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+      }
+      if (!same_content(t, m))
+         return false;
+
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+      {
+         if (t.remove(xs[i]) != (m.erase(xs[i]) == 1))
+            return false;
+         T v;
+         if (t.get(xs[i], v) || t.contains(xs[i]))
+            return false;
+      }
+      for (const auto& kv : m)
+      {
+         T v;
+         if (!t.get(kv.first, v) || v != kv.second)
+            return false;
+      }
+      return same_content(t, m);
+   }
+};
+
+template <typename PropertyType, typename ValueType,
+          std::size_t max_tests = 100>
+static void check_prop()
+{
+   using ctn_t = std::vector<ValueType>;
+   ac::check<ctn_t>(PropertyType(), max_tests, ac::make_arbitrary<ctn_t>(),
+                    ac::gtest_reporter());
+}
+
+// Counts the instances alive, so that leaks and early frees show.
+struct counted_t
+{
+   static std::atomic<int>& nb_alive()
+   {
+      static std::atomic<int> n(0);
+      return n;
+   }
+
+   counted_t(int v = 0): m_v(v) { ++nb_alive(); }
+   counted_t(const counted_t& other): m_v(other.m_v) { ++nb_alive(); }
+   counted_t& operator=(const counted_t&) = default;
+   ~counted_t() { --nb_alive(); }
+
+   int m_v;
+};
+
+TEST(skip_list_test_t, basic)
+{
+   ds::skip_list_t<int, int> t;
+   int v = 0;
+   EXPECT_EQ(0u, t.size());
+   EXPECT_FALSE(t.get(1, v));
+   EXPECT_FALSE(t.remove(1));
+
+   t.put(2, 20);
+   t.put(1, 10);
+   t.put(2, 21);
+   EXPECT_EQ(2u, t.size());
+   ASSERT_TRUE(t.get(2, v));
+   EXPECT_EQ(21, v);
+
+   EXPECT_TRUE(t.remove(1));
+   EXPECT_FALSE(t.remove(1));
+   EXPECT_EQ(1u, t.size());
+   EXPECT_FALSE(t.contains(1));
+   EXPECT_TRUE(t.contains(2));
+}
+
+TEST(skip_list_test_t, put_remove_int)
+{
+   check_prop<prop_put_remove_t, int>();
+}
+
+TEST(skip_list_test_t, put_remove_string)
+{
+   check_prop<prop_put_remove_t, std::string>();
+}
+
+TEST(skip_list_test_t, reclaim)
+{
+   {
+      ds::skip_list_t<int, counted_t> t;
+      for (int i = 0; i < 1000; ++i)
+         t.put(i % 300, counted_t(i));
+      for (int i = 0; i < 100; ++i)
+         t.remove(i);
+      EXPECT_EQ(200u, t.size());
+
+      // without readers, retired memory waits for a few more retirements
+      // at most
+      EXPECT_GE(200 + 64, counted_t::nb_alive());
+   }
+   EXPECT_EQ(0, counted_t::nb_alive());
+}
+
+TEST(skip_list_test_t, concurrent_writers)
+{
+   // every thread inserts its own keys and removes half of them, while all
+   // of them fight over a few shared keys
+   const int nb_threads = 4;
+   const int n = 2000;
+   const int nb_shared = 8;
+   ds::skip_list_t<int, counted_t> t;
+   std::atomic<bool> consistent(true);
+
+   std::vector<std::thread> writers;
+   for (int w = 0; w < nb_threads; ++w)
+   {
+      writers.emplace_back([&, w] {
+         for (int i = 0; i < n; ++i)
+         {
+            const auto k = nb_shared + i * nb_threads + w;
+            t.put(k, counted_t(-k));
+            t.put(i % nb_shared, counted_t(i % nb_shared));
+            if (i % 2)
+               t.remove(k);
+            if (i % 3 == w % 3)
+               t.remove(i % nb_shared);
+
+            counted_t v;
+            const bool kept = i % 2 == 0;
+            if (t.get(k, v) != kept || (kept && v.m_v != -k))
+               consistent = false;
+            if (t.get(i % nb_shared, v) && v.m_v != i % nb_shared)
+               consistent = false;
+         }
+      });
+   }
+   for (auto& w : writers)
+      w.join();
+   EXPECT_TRUE(consistent);
+
+   int prev = -1;
+   std::size_t count = 0;
+   t.for_each([&](int k, const counted_t& v) {
+      if (k <= prev || (k >= nb_shared &&
+                        ((k - nb_shared) / nb_threads % 2 || v.m_v != -k)))
+         consistent = false;
+      prev = k;
+      ++count;
+   });
+   EXPECT_TRUE(consistent);
+   EXPECT_EQ(count, t.size());
+   EXPECT_LE(static_cast<std::size_t>(nb_threads * n / 2), count);
+}
+
+TEST(skip_list_test_t, concurrent_readers)
+{
+   // the writer inserts keys in order then removes them in reverse: readers
+   // always see a prefix of [0, n)
+   const int n = 2000;
+   ds::skip_list_t<int, int> t;
+   std::atomic<bool> done(false);
+   std::atomic<bool> consistent(true);
+
+   std::vector<std::thread> readers;
+   for (int r = 0; r < 3; ++r)
+   {
+      readers.emplace_back([&] {
+         while (!done)
+         {
+            int expected = 0;
+            t.for_each([&](int k, int v) {
+               if (k != expected || v != -k)
+                  consistent = false;
+               ++expected;
+            });
+
+            int v = 0;
+            if (t.get(expected / 2, v) && v != -expected / 2)
+               consistent = false;
+         }
+      });
+   }
+
+   for (int i = 0; i < n; ++i)
+      t.put(i, -i);
+   for (int i = n - 1; i >= n / 2; --i)
+      t.remove(i);
+   done = true;
+   for (auto& r : readers)
+      r.join();
+
+   EXPECT_TRUE(consistent);
+   EXPECT_EQ(static_cast<std::size_t>(n / 2), t.size());
+}
@@ -1,13 +1,20 @@
 #include <ds/bs_tree.hpp>
+#include <ds/crb_tree.hpp>
 #include <ds/rb_tree.hpp>
 
 #include <gtest/gtest.h>
 
 #include <autocheck/autocheck.hpp>
 
+#include <algorithm>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <random>
 #include <set>
+#include <string>
 #include <utility>
+#include <vector>
 
 namespace ac = autocheck;
 
@@ -31,19 +38,127 @@ static void check_remove(TreeType& t, const KeyType& key)
 
 struct rb_tree_factory_t
 {
-   template <typename T>
-   static ds::rb_tree_t<T, T> instance()
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::rb_tree_t<T, V, L> instance()
    {
-      return ds::rb_tree_t<T, T>();
+      return ds::rb_tree_t<T, V, L>();
    }
 };
 
 struct bs_tree_factory_t
 {
-   template <typename T>
-   static ds::bs_tree_t<T, T> instance()
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::bs_tree_t<T, V, L> instance()
+   {
+      return ds::bs_tree_t<T, V, L>();
+   }
+};
+
+struct crb_tree_factory_t
+{
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::crb_tree_t<T, V, L> instance()
+   {
+      return ds::crb_tree_t<T, V, L>();
+   }
+};
+
+struct compact_rb_tree_factory_t
+{
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::compact_rb_tree_t<T, V, L> instance()
+   {
+      return ds::compact_rb_tree_t<T, V, L>();
+   }
+};
+
+struct compact_crb_tree_factory_t
+{
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::compact_crb_tree_t<T, V, L> instance()
+   {
+      return ds::compact_crb_tree_t<T, V, L>();
+   }
+};
+
+struct rb_pool_tree_factory_t
+{
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::rb_tree_t<T, V, L, ds::pool_alloc_t> instance()
+   {
+      return ds::rb_tree_t<T, V, L, ds::pool_alloc_t>();
+   }
+};
+
+struct bs_pool_tree_factory_t
+{
+   template <typename T, typename V = T, typename L = std::less<T>>
+   static ds::bs_tree_t<T, V, L, ds::pool_alloc_t> instance()
    {
-      return ds::bs_tree_t<T, T>();
+      return ds::bs_tree_t<T, V, L, ds::pool_alloc_t>();
+   }
+};
+
+// Value counting the moves out of its instances.
+struct move_counter_t
+{
+   move_counter_t() = default;
+
+   move_counter_t(move_counter_t&&)
+   {
+      ++nb_moves();
+   }
+
+   move_counter_t& operator=(move_counter_t&&)
+   {
+      ++nb_moves();
+      return *this;
+   }
+
+   static int& nb_moves()
+   {
+      static int n = 0;
+      return n;
+   }
+};
+
+// Name that does not convert to std::string, only a transparent comparator
+// lets it reach the stored keys.
+struct name_view_t
+{
+   const char* m_data;
+   std::size_t m_size;
+};
+
+struct name_less_t
+{
+   using is_transparent = void;
+
+   static int compare(const char* l, std::size_t ln,
+                      const char* r, std::size_t rn)
+   {
+      const auto c = std::char_traits<char>::compare(l, r, std::min(ln, rn));
+      return c != 0 ? c : (ln < rn ? -1 : (rn < ln ? 1 : 0));
+   }
+
+   bool operator()(const std::string& l, const std::string& r) const
+   {
+      return l < r;
+   }
+
+   bool operator()(const std::string& l, const name_view_t& r) const
+   {
+      return compare(l.data(), l.size(), r.m_data, r.m_size) < 0;
+   }
+
+   bool operator()(const name_view_t& l, const std::string& r) const
+   {
+      return compare(l.m_data, l.m_size, r.data(), r.size()) < 0;
+   }
+
+   bool operator()(const name_view_t& l, const name_view_t& r) const
+   {
+      return compare(l.m_data, l.m_size, r.m_data, r.m_size) < 0;
    }
 };
 
@@ -97,6 +212,386 @@ struct prop_insert_delete_t
    }
 };
 
+template <typename TreeFactoryType>
+struct prop_put_hint_t
+{
+   // Puts xs with the last element put, then the first element, as hints.
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      std::map<T, T> m;
+      auto hint = t.end();
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         hint = t.put_hint(hint, xs[i], xs[xs.size() - i - 1]);
+         m[xs[i]] = xs[xs.size() - i - 1];
+         if (hint->first != xs[i] || hint->second != m[xs[i]])
+            return false;
+      }
+      for (const auto& x : xs)
+      {
+         t.put_hint(t.begin(), x, x);
+         m[x] = x;
+      }
+
+      if (!std::equal(m.begin(), m.end(), t.begin(),
+                      [](const std::pair<const T, T>& p,
+                         const std::pair<const T&, const T&>& q)
+                      {
+                         return p.first == q.first && p.second == q.second;
+                      }))
+         return false;
+
+      for (const auto& kv : m)
+         t.remove(kv.first);
+      return t.size() == 0;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_size_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      std::set<T> ss;
+
+      for (const auto& x : xs)
+      {
+         const auto key = x / 2;
+         if (x % 2 == 0)
+         {
+            t.put(key, x);
+            ss.insert(key);
+         }
+         else
+         {
+            t.remove(key);
+            ss.erase(key);
+         }
+
+         if (t.size() != ss.size())
+            return false;
+      }
+
+      return true;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_rank_select_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      std::set<T> ss;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[i]);
+         ss.insert(xs[i]);
+         if (i % 3 == 2)
+         {
+            t.remove(xs[i - 1]);
+            ss.erase(xs[i - 1]);
+         }
+      }
+
+      std::size_t r = 0;
+      for (const auto& x : ss)
+      {
+         if (t.rank(x) != r)
+            return false;
+
+         const auto k = t.select(r);
+         if (!k || *k != x)
+            return false;
+
+         ++r;
+      }
+
+      return t.select(ss.size()) == nullptr;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_iterate_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      std::map<T, T> m;
+
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         t.put(xs[i], xs[i]);
+         m[xs[i]] = xs[i];
+         if (i % 4 == 3)
+         {
+            t.remove(xs[i - 2]);
+            m.erase(xs[i - 2]);
+         }
+      }
+
+      if (!std::equal(m.begin(), m.end(), t.begin(),
+                      [](const std::pair<const T, T>& p,
+                         const std::pair<const T&, const T&>& q)
+                      {
+                         return p.first == q.first && p.second == q.second;
+                      }))
+         return false;
+
+      if (std::distance(t.begin(), t.end()) !=
+          static_cast<std::ptrdiff_t>(m.size()))
+         return false;
+
+      auto it = t.end();
+      for (auto mit = m.rbegin(); mit != m.rend(); ++mit)
+      {
+         --it;
+         if (it->first != mit->first)
+            return false;
+      }
+
+      for (const auto& x : xs)
+      {
+         const auto lb = t.lower_bound(x);
+         const auto mlb = m.lower_bound(x);
+         if ((lb == t.end()) != (mlb == m.end()) ||
+             (lb != t.end() && lb->first != mlb->first))
+            return false;
+
+         const auto ub = t.upper_bound(x);
+         const auto mub = m.upper_bound(x);
+         if ((ub == t.end()) != (mub == m.end()) ||
+             (ub != t.end() && ub->first != mub->first))
+            return false;
+      }
+
+      return true;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_get_many_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      for (std::size_t i = 0; i < xs.size(); i += 2)
+         t.put(xs[i], xs[i]);
+
+      std::vector<typename decltype(t)::value_t*> values;
+      t.get_many(xs.begin(), xs.end(), std::back_inserter(values));
+      if (values.size() != xs.size())
+         return false;
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         if (values[i] != t.get(xs[i]))
+            return false;
+      }
+      return true;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_assign_sorted_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      const std::map<T, T> m = make_map(xs);
+      auto t = TreeFactoryType::template instance<T>();
+      t.put(xs.empty() ? T() : xs.front(), T());
+      t.assign_sorted(m.begin(), m.end());
+
+      if (t.size() != m.size())
+         return false;
+
+      if (!std::equal(m.begin(), m.end(), t.begin(),
+                      [](const std::pair<const T, T>& p,
+                         const std::pair<const T&, const T&>& q)
+                      {
+                         return p.first == q.first && p.second == q.second;
+                      }))
+         return false;
+
+      std::size_t r = 0;
+      for (const auto& kv : m)
+      {
+         if (t.rank(kv.first) != r++)
+            return false;
+      }
+
+      // put and remove check the tree invariants in debug builds
+      for (const auto& kv : m)
+      {
+         t.remove(kv.first);
+         t.put(kv.first, kv.second);
+      }
+
+      return t.size() == m.size();
+   }
+
+   template <typename T>
+   static std::map<T, T> make_map(const std::vector<T>& xs)
+   {
+      std::map<T, T> m;
+      for (std::size_t i = 0; i < xs.size(); ++i)
+         m[xs[i]] = xs[xs.size() - i - 1];
+      return m;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_split_join_t
+{
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      if (xs.empty())
+         return true;
+
+      const auto m = prop_assign_sorted_t<TreeFactoryType>::make_map(xs);
+      auto t = TreeFactoryType::template instance<T>();
+      for (const auto& kv : m)
+         t.put(kv.first, kv.second);
+
+      // xs.front() is a key of the tree, xs.back() too
+      const auto& pivot = xs.front();
+      auto right = t.split(pivot);
+      if (!same_content(t, m.begin(), m.lower_bound(pivot)) ||
+          !same_content(right, m.lower_bound(pivot), m.end()))
+         return false;
+
+      const T value = *right.get(pivot);
+      right.remove(pivot);
+      t.join(pivot, value, right);
+      if (right.size() != 0 || !same_content(t, m.begin(), m.end()))
+         return false;
+
+      right = t.split(xs.back());
+      t.join(right);
+      if (right.size() != 0 || !same_content(t, m.begin(), m.end()))
+         return false;
+
+      // put and remove check the tree invariants in debug builds
+      for (const auto& x : xs)
+         t.remove(x);
+      return t.size() == 0;
+   }
+
+   template <typename TreeType, typename IteratorType>
+   static bool same_content(const TreeType& t, IteratorType begin,
+                            IteratorType end)
+   {
+      using T = typename TreeType::key_t;
+      return t.size() == static_cast<std::size_t>(std::distance(begin, end))
+         && std::equal(begin, end, t.begin(),
+                       [](const std::pair<const T, T>& p,
+                          const std::pair<const T&, const T&>& q)
+                       {
+                          return p.first == q.first && p.second == q.second;
+                       });
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_put_batch_t
+{
+   // Puts the first elements of xs one by one, then the others as a batch
+   // that repeats some keys, small or large relative to the tree.
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      for (auto nb_put : {xs.size() / 2, xs.size() * 9 / 10})
+      {
+         auto t = TreeFactoryType::template instance<T>();
+         std::map<T, T> m;
+         std::vector<std::pair<T, T>> batch;
+         for (std::size_t i = 0; i < xs.size(); ++i)
+         {
+            const auto value = xs[xs.size() - i - 1];
+            if (i < nb_put)
+               t.put(xs[i], value);
+            else
+               batch.emplace_back(xs[i], value);
+            m[xs[i]] = value;
+         }
+         for (std::size_t i = 0; i < batch.size(); i += 3)
+         {
+            batch.emplace_back(batch[i].first, xs[i]);
+            m[batch[i].first] = xs[i];
+         }
+
+         t.put_batch(batch.begin(), batch.end());
+         if (!prop_split_join_t<TreeFactoryType>::same_content(t, m.begin(),
+                                                               m.end()))
+            return false;
+         for (const auto& kv : m)
+            t.remove(kv.first);
+         if (t.size() != 0)
+            return false;
+      }
+      return true;
+   }
+};
+
+template <typename TreeFactoryType>
+struct prop_set_ops_t
+{
+   // Splits xs into the keys of a and those of b, which repeat some of
+   // them with other values.
+   template <typename T>
+   bool operator() (const std::vector<T>& xs) const
+   {
+      std::map<T, T> ma;
+      std::map<T, T> mb;
+      for (std::size_t i = 0; i < xs.size(); ++i)
+      {
+         if (i % 3 == 0)
+            ma[xs[i]] = xs[xs.size() - i - 1];
+         else
+            mb[xs[i]] = xs[i];
+      }
+
+      std::map<T, T> m_union(mb);
+      std::map<T, T> m_intersection;
+      std::map<T, T> m_difference;
+      for (const auto& kv : ma)
+      {
+         m_union.insert(kv);
+         if (mb.count(kv.first))
+            m_intersection.insert(kv);
+         else
+            m_difference.insert(kv);
+      }
+
+      using same_t = prop_split_join_t<TreeFactoryType>;
+      return same_t::same_content(ds::set_union(make(ma), make(mb), 2),
+                                  m_union.begin(), m_union.end())
+         && same_t::same_content(ds::set_intersection(make(ma), make(mb), 2),
+                                 m_intersection.begin(), m_intersection.end())
+         && same_t::same_content(ds::set_difference(make(ma), make(mb), 2),
+                                 m_difference.begin(), m_difference.end());
+   }
+
+   template <typename T>
+   static auto make(const std::map<T, T>& m)
+      -> decltype(TreeFactoryType::template instance<T>())
+   {
+      auto t = TreeFactoryType::template instance<T>();
+      for (const auto& kv : m)
+         t.put(kv.first, kv.second);
+      return t;
+   }
+};
+
 template <typename PropertyType, typename ValueType,
           std::size_t max_tests = 100>
 static void check_prop()
@@ -107,7 +602,9 @@ static void check_prop()
 }
 
 using tree_factory_types_t =
-   testing::Types<bs_tree_factory_t, rb_tree_factory_t>;
+   testing::Types<bs_tree_factory_t, rb_tree_factory_t, crb_tree_factory_t,
+                  compact_rb_tree_factory_t, compact_crb_tree_factory_t,
+                  bs_pool_tree_factory_t, rb_pool_tree_factory_t>;
 
 template <class T>
 class tree_test_t : public testing::Test
@@ -167,3 +664,583 @@ TYPED_TEST(tree_test_t, insert_delete_string)
 {
    check_prop<prop_insert_delete_t<TypeParam>, std::string>();
 }
+
+TYPED_TEST(tree_test_t, put_hint_int)
+{
+   check_prop<prop_put_hint_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, put_hint_string)
+{
+   check_prop<prop_put_hint_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(tree_test_t, put_sorted)
+{
+   // appended past the largest key, or put before the smallest with a hint
+   auto t = TypeParam::template instance<int>();
+   const int n = 200;
+   for (int i = 0; i < n; ++i)
+      t.put(i, i);
+   for (int i = -1; i >= -n; --i)
+      t.put_hint(t.begin(), i, i);
+
+   EXPECT_EQ(static_cast<std::size_t>(2 * n), t.size());
+   int expected = -n;
+   for (const auto& kv : t)
+   {
+      EXPECT_EQ(expected, kv.first);
+      EXPECT_EQ(expected, kv.second);
+      ++expected;
+   }
+   EXPECT_EQ(static_cast<std::size_t>(n), t.rank(0));
+}
+
+TYPED_TEST(tree_test_t, put_batch_int)
+{
+   check_prop<prop_put_batch_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, put_batch_string)
+{
+   check_prop<prop_put_batch_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(tree_test_t, put_batch_move_only)
+{
+   using value_t = std::unique_ptr<int>;
+   auto t = TypeParam::template instance<int, value_t>();
+   for (int i = 0; i < 10; ++i)
+      t.put(i, value_t(new int(i)));
+   const auto it = t.lower_bound(3);
+
+   // as large as the tree: rebuilt out of its nodes
+   std::vector<std::pair<int, value_t>> batch;
+   for (int i = 5; i < 25; ++i)
+      batch.emplace_back(i, value_t(new int(-i)));
+   t.put_batch(std::make_move_iterator(batch.begin()),
+               std::make_move_iterator(batch.end()));
+   EXPECT_EQ(25, t.size());
+   for (int i = 0; i < 25; ++i)
+      EXPECT_EQ(i < 5 ? i : -i, **t.get(i));
+   EXPECT_EQ(3, it->first);
+   EXPECT_EQ(3, *it->second);
+
+   // smaller than the tree: merged in place
+   batch.clear();
+   batch.emplace_back(30, value_t(new int(30)));
+   batch.emplace_back(0, value_t(new int(-100)));
+   t.put_batch(std::make_move_iterator(batch.begin()),
+               std::make_move_iterator(batch.end()));
+   EXPECT_EQ(26, t.size());
+   EXPECT_EQ(-100, **t.get(0));
+   EXPECT_EQ(30, **t.get(30));
+}
+
+TYPED_TEST(tree_test_t, size_put_remove_int)
+{
+   check_prop<prop_size_t<TypeParam>, int, 500>();
+}
+
+TYPED_TEST(tree_test_t, rank_select)
+{
+   auto t = TypeParam::template instance<int>();
+   EXPECT_EQ(0, t.rank(5));
+   EXPECT_EQ(nullptr, t.select(0));
+
+   for (int i = 0; i < 10; ++i)
+      t.put(2 * i, i);
+
+   EXPECT_EQ(0, t.rank(-1));
+   EXPECT_EQ(0, t.rank(0));
+   EXPECT_EQ(1, t.rank(1));
+   EXPECT_EQ(5, t.rank(10));
+   EXPECT_EQ(10, t.rank(42));
+   EXPECT_EQ(0, *t.select(0));
+   EXPECT_EQ(8, *t.select(4));
+   EXPECT_EQ(18, *t.select(9));
+   EXPECT_EQ(nullptr, t.select(10));
+
+   t.remove(8);
+   EXPECT_EQ(4, t.rank(10));
+   EXPECT_EQ(10, *t.select(4));
+}
+
+TYPED_TEST(tree_test_t, rank_select_int)
+{
+   check_prop<prop_rank_select_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, get_many_int)
+{
+   check_prop<prop_get_many_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, get_many_string)
+{
+   check_prop<prop_get_many_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(tree_test_t, iterate)
+{
+   auto t = TypeParam::template instance<int>();
+   EXPECT_TRUE(t.begin() == t.end());
+   EXPECT_EQ(nullptr, t.min());
+   EXPECT_EQ(nullptr, t.max());
+
+   for (int i : {5, 1, 9, 3, 7})
+      t.put(i, 10 * i);
+
+   std::vector<int> keys;
+   for (const auto& kv : t)
+   {
+      EXPECT_EQ(10 * kv.first, kv.second);
+      keys.push_back(kv.first);
+   }
+   EXPECT_EQ(std::vector<int>({1, 3, 5, 7, 9}), keys);
+
+   EXPECT_EQ(1, *t.min());
+   EXPECT_EQ(9, *t.max());
+
+   auto it = t.lower_bound(4);
+   ASSERT_TRUE(it != t.end());
+   EXPECT_EQ(5, it->first);
+   it->second = 51;
+   check_get(t, 5, 51);
+   EXPECT_EQ(3, (--it)->first);
+   EXPECT_EQ(5, t.upper_bound(3)->first);
+   EXPECT_TRUE(t.upper_bound(9) == t.end());
+   EXPECT_EQ(9, std::prev(t.end())->first);
+
+   keys.clear();
+   for (const auto& kv : t.range(2, 7))
+      keys.push_back(kv.first);
+   EXPECT_EQ(std::vector<int>({3, 5, 7}), keys);
+   EXPECT_TRUE(t.range(7, 2).empty());
+   EXPECT_TRUE(t.range(10, 12).empty());
+
+   const auto& ct = t;
+   decltype(ct.begin()) cit = t.begin();
+   EXPECT_EQ(1, cit->first);
+}
+
+TYPED_TEST(tree_test_t, remove_keeps_iterators)
+{
+   auto t = TypeParam::template instance<int>();
+   const int n = 100;
+   std::vector<typename decltype(t)::iterator> its;
+   for (int i = 0; i < n; ++i)
+      its.push_back(t.insert_or_assign(i, 10 * i).first);
+
+   // removing a key must not move the others, its successor in particular
+   std::vector<int> removed;
+   for (int i = 0; i < n; i += 2)
+      removed.push_back(i);
+   std::shuffle(removed.begin(), removed.end(), std::mt19937(7));
+   for (int key : removed)
+   {
+      t.remove(key);
+      for (int i = 1; i < n; i += 2)
+      {
+         EXPECT_EQ(i, its[i]->first);
+         EXPECT_EQ(10 * i, its[i]->second);
+      }
+   }
+   EXPECT_TRUE(its[1] == t.begin());
+}
+
+TYPED_TEST(tree_test_t, max_follows_changes)
+{
+   auto t = TypeParam::template instance<int>();
+   std::set<int> ss;
+   std::mt19937 gen(3);
+   std::uniform_int_distribution<int> dist(0, 63);
+   auto hint = t.end();
+
+   for (int i = 0; i < 2000; ++i)
+   {
+      const int key = dist(gen);
+      switch (i % 4)
+      {
+      case 0:
+         t.put(key, key);
+         ss.insert(key);
+         break;
+      case 1:
+         hint = t.put_hint(hint, key, key);
+         ss.insert(key);
+         break;
+      default:
+         // removes the largest key half of the time
+         const int k = i % 8 == 2 && !ss.empty() ? *ss.rbegin() : key;
+         t.remove(k);
+         ss.erase(k);
+         hint = t.end();
+         break;
+      }
+
+      if (ss.empty())
+         ASSERT_EQ(nullptr, t.max());
+      else
+         ASSERT_EQ(*ss.rbegin(), *t.max());
+   }
+
+   std::vector<std::pair<int, int>> batch;
+   for (int i = 0; i < 100; ++i)
+      batch.emplace_back(2 * i, i);
+   t.put_batch(batch.begin(), batch.end());
+   EXPECT_EQ(198, *t.max());
+
+   auto moved = std::move(t);
+   EXPECT_EQ(198, *moved.max());
+   moved.clear();
+   EXPECT_EQ(nullptr, moved.max());
+}
+
+TYPED_TEST(tree_test_t, self_move_assign)
+{
+   auto t = TypeParam::template instance<int>();
+   for (int i = 0; i < 10; ++i)
+      t.put(i, i);
+
+   auto& alias = t;
+   t = std::move(alias);
+   EXPECT_EQ(10, t.size());
+   for (int i = 0; i < 10; ++i)
+      check_get(t, i, i);
+}
+
+TYPED_TEST(tree_test_t, iterate_int)
+{
+   check_prop<prop_iterate_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, iterate_string)
+{
+   check_prop<prop_iterate_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(tree_test_t, assign_sorted)
+{
+   using tree_t = decltype(TypeParam::template instance<int>());
+   for (int n = 0; n < 200; ++n)
+   {
+      std::vector<std::pair<int, int>> kvs;
+      for (int i = 0; i < n; ++i)
+         kvs.emplace_back(2 * i, i);
+
+      tree_t t(kvs.begin(), kvs.end());
+      ASSERT_EQ(static_cast<std::size_t>(n), t.size());
+      for (int i = 0; i < n; ++i)
+         check_get(t, 2 * i, i);
+
+      t.put(-1, -1);
+      t.put(2 * n + 1, 0);
+      t.remove(2 * (n / 2));
+      EXPECT_EQ(static_cast<std::size_t>(n) + (n > 0 ? 1 : 2), t.size());
+   }
+}
+
+TYPED_TEST(tree_test_t, assign_sorted_int)
+{
+   check_prop<prop_assign_sorted_t<TypeParam>, int>();
+}
+
+TYPED_TEST(tree_test_t, assign_sorted_string)
+{
+   check_prop<prop_assign_sorted_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(tree_test_t, emplace)
+{
+   auto t = TypeParam::template instance<int, std::string>();
+
+   auto r = t.emplace(1, 3, 'a');
+   EXPECT_TRUE(r.second);
+   EXPECT_EQ(1, r.first->first);
+   EXPECT_EQ("aaa", r.first->second);
+
+   r = t.try_emplace(1, "b");
+   EXPECT_FALSE(r.second);
+   EXPECT_EQ("aaa", r.first->second);
+
+   r = t.try_emplace(2, "b");
+   EXPECT_TRUE(r.second);
+   check_get(t, 2, std::string("b"));
+
+   r = t.insert_or_assign(2, "c");
+   EXPECT_FALSE(r.second);
+   check_get(t, 2, std::string("c"));
+
+   std::string v(100, 'd');
+   t.put(3, std::move(v));
+   EXPECT_TRUE(v.empty());
+   check_get(t, 3, std::string(100, 'd'));
+   EXPECT_EQ(3, t.size());
+}
+
+TYPED_TEST(tree_test_t, move_only_value)
+{
+   auto t = TypeParam::template instance<int, std::unique_ptr<int>>();
+
+   for (int i = 0; i < 64; ++i)
+      t.put(i, std::unique_ptr<int>(new int(i)));
+   t.try_emplace(64, new int(64));
+   t.insert_or_assign(0, std::unique_ptr<int>(new int(-1)));
+   EXPECT_EQ(65, t.size());
+   EXPECT_EQ(-1, **t.get(0));
+
+   for (int i = 0; i < 64; i += 2)
+      t.remove(i);
+
+   for (int i = 1; i < 65; i += 2)
+   {
+      auto v = t.get(i);
+      ASSERT_TRUE(v != nullptr);
+      EXPECT_EQ(i, **v);
+   }
+   EXPECT_EQ(33, t.size());
+}
+
+TYPED_TEST(tree_test_t, insert_or_assign_moves_once)
+{
+   auto t = TypeParam::template instance<int, move_counter_t>();
+   move_counter_t::nb_moves() = 0;
+
+   // inserts, the first one into the empty tree, the last one past the
+   // largest key, the others below it
+   for (int i : {5, 1, 3, 9})
+   {
+      move_counter_t v;
+      t.insert_or_assign(i, std::move(v));
+   }
+   EXPECT_EQ(4, move_counter_t::nb_moves());
+
+   // assignments
+   for (int i : {5, 1, 9})
+   {
+      move_counter_t v;
+      t.insert_or_assign(i, std::move(v));
+   }
+   EXPECT_EQ(7, move_counter_t::nb_moves());
+   EXPECT_EQ(4, t.size());
+}
+
+TYPED_TEST(tree_test_t, remove_missing)
+{
+   auto t = TypeParam::template instance<int>();
+   t.remove(3);
+   EXPECT_EQ(0, t.size());
+
+   t.put(1, 1);
+   t.put(2, 2);
+   t.remove(3);
+   EXPECT_EQ(2, t.size());
+   check_get(t, 1, 1);
+   check_get(t, 2, 2);
+
+   // missing keys between present ones, at every depth
+   for (int i = 4; i < 200; i += 2)
+      t.put(i, i);
+   for (int i = 3; i < 201; i += 2)
+      t.remove(i);
+   t.remove(-1);
+   EXPECT_EQ(100, t.size());
+   check_get(t, 1, 1);
+   for (int i = 4; i < 200; i += 2)
+      check_get(t, i, i);
+}
+
+TYPED_TEST(tree_test_t, transparent_lookup)
+{
+   auto t = TypeParam::template instance<std::string, int, name_less_t>();
+   const char* names[] = {"ada", "bob", "carl", "dan", "eve"};
+   for (int i = 0; i < 5; ++i)
+      t.put(names[i], i);
+
+   const auto view = [](const char* s) {
+      return name_view_t{s, std::char_traits<char>::length(s)};
+   };
+
+   check_get(t, view("carl"), 2);
+   EXPECT_EQ(nullptr, t.get(view("car")));
+   EXPECT_EQ(2u, t.rank(view("carl")));
+   EXPECT_EQ(3u, t.rank(view("cb")));
+   EXPECT_EQ("dan", t.lower_bound(view("cb"))->first);
+   EXPECT_EQ("dan", t.upper_bound(view("carl"))->first);
+
+   const auto& ct = t;
+   std::vector<std::string> keys;
+   for (auto kv: ct.range(view("b"), view("d")))
+      keys.push_back(kv.first);
+   EXPECT_EQ(std::vector<std::string>({"bob", "carl"}), keys);
+
+   t.remove(view("eve"));
+   t.remove(view("zed"));
+   EXPECT_EQ(4u, t.size());
+   EXPECT_EQ(nullptr, t.get(view("eve")));
+
+   // key_t arguments still take the plain overloads
+   check_get(t, std::string("ada"), 0);
+   t.remove(std::string("ada"));
+   EXPECT_EQ(3u, t.size());
+}
+
+using join_tree_factory_types_t =
+   testing::Types<rb_tree_factory_t, compact_rb_tree_factory_t>;
+
+template <class T>
+class join_tree_test_t : public testing::Test
+{
+};
+
+TYPED_TEST_CASE(join_tree_test_t, join_tree_factory_types_t);
+
+TYPED_TEST(join_tree_test_t, split_join_int)
+{
+   check_prop<prop_split_join_t<TypeParam>, int>();
+}
+
+TYPED_TEST(join_tree_test_t, split_join_string)
+{
+   check_prop<prop_split_join_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(join_tree_test_t, split_everywhere)
+{
+   const int n = 100;
+   for (int k = -1; k <= 2 * n + 1; ++k)
+   {
+      auto t = TypeParam::template instance<int>();
+      for (int i = 0; i < n; ++i)
+         t.put(2 * i, i);
+
+      auto right = t.split(k);
+      const auto nb_left = static_cast<std::size_t>(std::min(n, (k + 1) / 2));
+      EXPECT_EQ(nb_left, t.size());
+      EXPECT_EQ(n - nb_left, right.size());
+      EXPECT_TRUE(t.max() == nullptr || *t.max() < k);
+      EXPECT_TRUE(right.min() == nullptr || *right.min() >= k);
+      EXPECT_TRUE(right.max() == nullptr || *right.max() == 2 * n - 2);
+
+      t.join(right);
+      EXPECT_EQ(static_cast<std::size_t>(n), t.size());
+      EXPECT_EQ(2 * n - 2, *t.max());
+      EXPECT_EQ(static_cast<std::size_t>(k / 2), t.rank(k - k % 2));
+   }
+}
+
+TYPED_TEST(join_tree_test_t, join_uneven)
+{
+   // one tree much taller than the other, on either side
+   for (int n : {0, 1, 2, 3, 300})
+   {
+      auto small = TypeParam::template instance<int>();
+      auto large = TypeParam::template instance<int>();
+      for (int i = 0; i < n; ++i)
+         small.put(i, i);
+      for (int i = 0; i < 300; ++i)
+         large.put(2000 + i, i);
+      small.join(1500, -1, large);
+      EXPECT_EQ(static_cast<std::size_t>(n + 301), small.size());
+      EXPECT_EQ(2299, *small.max());
+      EXPECT_EQ(nullptr, large.max());
+      EXPECT_EQ(static_cast<std::size_t>(n), small.rank(1500));
+
+      auto left = TypeParam::template instance<int>();
+      auto tail = TypeParam::template instance<int>();
+      for (int i = 0; i < 300; ++i)
+         left.put(i, i);
+      for (int i = 0; i < n; ++i)
+         tail.put(2000 + i, i);
+      left.join(tail);
+      EXPECT_EQ(static_cast<std::size_t>(n + 300), left.size());
+      EXPECT_EQ(n ? 2000 + n - 1 : 299, *left.max());
+      EXPECT_EQ(0u, tail.size());
+      left.put(1500, -1);
+      EXPECT_EQ(300u, left.rank(1500));
+   }
+}
+
+TYPED_TEST(join_tree_test_t, set_ops_int)
+{
+   check_prop<prop_set_ops_t<TypeParam>, int>();
+}
+
+TYPED_TEST(join_tree_test_t, set_ops_string)
+{
+   check_prop<prop_set_ops_t<TypeParam>, std::string>();
+}
+
+TYPED_TEST(join_tree_test_t, set_ops_parallel)
+{
+   // large enough for the recursion to fork: multiples of 2 against
+   // multiples of 3
+   const int n = 60000;
+   const auto make = [](int step, int value) {
+      std::vector<std::pair<int, int>> kvs;
+      for (int k = 0; k < n; k += step)
+         kvs.emplace_back(k, value);
+      auto t = TypeParam::template instance<int>();
+      t.assign_sorted(kvs.begin(), kvs.end());
+      return t;
+   };
+
+   const auto u = ds::set_union(make(2, 2), make(3, 3), 4);
+   EXPECT_EQ(static_cast<std::size_t>(n / 2 + n / 3 - n / 6), u.size());
+   for (int k = 0; k < n; ++k)
+   {
+      const auto v = u.get(k);
+      if (k % 3 == 0)
+         EXPECT_TRUE(v && *v == 3);
+      else if (k % 2 == 0)
+         EXPECT_TRUE(v && *v == 2);
+      else
+         EXPECT_EQ(nullptr, v);
+   }
+
+   const auto i = ds::set_intersection(make(2, 2), make(3, 3), 4);
+   EXPECT_EQ(static_cast<std::size_t>(n / 6), i.size());
+   for (const auto& kv : i)
+      EXPECT_TRUE(kv.first % 6 == 0 && kv.second == 2);
+
+   const auto d = ds::set_difference(make(2, 2), make(3, 3), 4);
+   EXPECT_EQ(static_cast<std::size_t>(n / 2 - n / 6), d.size());
+   for (const auto& kv : d)
+      EXPECT_TRUE(kv.first % 2 == 0 && kv.first % 3 != 0);
+}
+
+TEST(rb_tree_test_t, compact_node_size)
+{
+   using node_t = ds::detail::rbt_node_t<int, int, ds::heap_alloc_t>;
+   using compact_node_t =
+      ds::detail::rbt_compact_node_t<int, int, ds::heap_alloc_t>;
+   EXPECT_LT(sizeof(compact_node_t), sizeof(node_t));
+
+   compact_node_t node(nullptr, compact_node_t::color_t::black, 1, 2);
+   EXPECT_EQ(compact_node_t::color_t::black, node.color());
+   node.set_parent(&node);
+   node.set_color(compact_node_t::color_t::red);
+   EXPECT_EQ(&node, node.parent());
+   EXPECT_EQ(compact_node_t::color_t::red, node.color());
+   node.set_color(compact_node_t::color_t::black);
+   EXPECT_EQ(&node, node.parent());
+   EXPECT_EQ(compact_node_t::color_t::black, node.color());
+}
+
+TEST(bs_tree_test_t, sorted_insert_deep)
+{
+   // sorted keys turn a bs_tree_t into a list, none of the operations may
+   // recurse along it
+   const int n = 1 << 13;
+   ds::bs_tree_t<int, int> t;
+   for (int i = 0; i < n; ++i)
+      t.put(i, i);
+   EXPECT_EQ(static_cast<std::size_t>(n), t.size());
+
+   check_get(t, n - 1, n - 1);
+   EXPECT_EQ(static_cast<std::size_t>(n - 1), t.rank(n - 1));
+   check_remove(t, n - 1);
+   check_remove(t, n / 2);
+   EXPECT_EQ(static_cast<std::size_t>(n - 2), t.size());
+}